@@ -4,6 +4,7 @@
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 
 #include "DomTree.h"
 
@@ -45,8 +46,8 @@ TEST(TestInvalidTable, invalidSmallTable)
 		EXPECT_EQ(1, childs->m_childs.size());	// body
 		if (1 == childs->m_childs.size())
 		{
-			if (1 == childs.get()->m_childs.size())
-				EXPECT_EQ(4, childs.get()->m_childs.at(0)->m_childs.size());	// body's childs
+			if (1 == childs->m_childs.size())
+				EXPECT_EQ(4, childs->m_childs.at(0)->m_childs.size());	// body's childs
 		}
 	}
 }
@@ -293,7 +294,7 @@ TEST(TestSite, multi_self_closing_tags)
 		auto& childs = dt.GetTags().at(0);
 		EXPECT_EQ(1, childs->m_childs.size());
 		if (1 == childs->m_childs.size())
-			EXPECT_EQ(8, childs.get()->m_childs.at(0)->m_childs.size());
+			EXPECT_EQ(8, childs->m_childs.at(0)->m_childs.size());
 	}
 }
 
@@ -310,10 +311,1187 @@ TEST(TestSite, style_with_comments)
 		auto& childs = dt.GetTags().at(0);
 		EXPECT_EQ(2, childs->m_childs.size());
 		if (2 == childs->m_childs.size())
-			EXPECT_EQ(1, childs.get()->m_childs.at(0)->m_childs.size());
+			EXPECT_EQ(1, childs->m_childs.at(0)->m_childs.size());
 	}
 }
 
+TEST(TestZeroCopy, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(html_file);
+	CDomTree dtView{ ParseOptions{ .m_zeroCopy = true } };
+	dtView.Parse(std::move(html_file));
+	EXPECT_EQ(dt.GetData(), dtView.GetData());
+	EXPECT_EQ(2, dtView.GetTags().size());
+	if (2 == dtView.GetTags().size())
+	{
+		auto& html = dtView.GetTags().at(1);
+		EXPECT_TRUE(html->m_name.IsView());
+		EXPECT_FALSE(dt.GetTags().at(1)->m_name.IsView());
+		html->m_name = "html";					// changed node owns its string
+		EXPECT_FALSE(html->m_name.IsView());
+		EXPECT_EQ("html", html->m_name);
+	}
+}
+
+TEST(TestZeroCopy, reparse)
+{
+	// the tags of a document are added to the tags of the previous ones, which still view their buffers
+	CDomTree dt{ ParseOptions{ .m_zeroCopy = true } };
+	dt.Parse(std::string("<html><body><p class=\"a\">first</p></body></html>"));
+	dt.Parse(std::string("<html><body><p class=\"b\">second</p></body></html>"));
+	const std::string third{ "<div id=\"c\">third</div>" };
+	dt.ParseView(third);
+	EXPECT_EQ(3, dt.GetTags().size());
+	EXPECT_TRUE(dt.GetTags().at(0)->m_name.IsView());
+	EXPECT_EQ("<html><body><p class=\"a\">first</p></body></html><html><body><p class=\"b\">second</p></body></html>" + third,
+		dt.GetData(DataFormat::compact));
+
+	dt.Clear();
+	dt.Parse(third);
+	EXPECT_EQ(third, dt.GetData(DataFormat::compact));
+}
+
+TEST(TestArena, addChild)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<html><body><p>abc</p></body></html>"));
+	EXPECT_EQ(1, dt.GetTags().size());
+	if (1 == dt.GetTags().size())
+	{
+		Tag* body = dt.GetTags().at(0)->m_childs.at(0);
+		Tag* div = body->AddChild(Tag{ "div", { { "class", "split left" } } });
+		EXPECT_NE(nullptr, div);
+		if (div)
+		{
+			EXPECT_NE(nullptr, div->AddText("bibi"));
+			EXPECT_EQ(body, div->m_parent);
+			EXPECT_EQ(2, body->m_childs.size());
+		}
+		Tag outside{ "div" };
+		EXPECT_EQ(nullptr, outside.AddChild(Tag{ "p" }));	// not owned by a tree
+	}
+	EXPECT_EQ("<html>\n\t<body>\n\t\t<p>abc</p>\n\t\t<div class=\"split left\">bibi</div>\n\t</body>\n</html>\n", dt.GetData());
+}
+
+TEST(TestArena, addChildCopy)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<div id=\"a\"><ul><li>one</li><li>two</li></ul></div><div id=\"b\"></div>"));
+	Tag* a = dt.GetElementById("a");
+	Tag* b = dt.GetElementById("b");
+	ASSERT_NE(nullptr, a);
+	ASSERT_NE(nullptr, b);
+	Tag* ul = a->m_childs.at(0);
+	Tag* copy = b->AddChild(*ul);
+	ASSERT_NE(nullptr, copy);
+	EXPECT_NE(ul, copy);
+	// the source keeps its place and its childs
+	EXPECT_EQ(a, ul->m_parent);
+	EXPECT_EQ(0, ul->m_childIndex);
+	for (const Tag* li : ul->m_childs)
+		EXPECT_EQ(ul, li->m_parent);
+	// the copy has its own childs, linked to it
+	EXPECT_EQ(b, copy->m_parent);
+	EXPECT_EQ(0, copy->m_childIndex);
+	ASSERT_EQ(2, copy->m_childs.size());
+	for (size_t i = 0; i < copy->m_childs.size(); ++i)
+	{
+		const Tag* li = copy->m_childs[i];
+		EXPECT_NE(ul->m_childs[i], li);
+		EXPECT_EQ(copy, li->m_parent);
+		EXPECT_EQ(i, li->m_childIndex);
+		ASSERT_EQ(1, li->m_childs.size());
+		EXPECT_EQ(li, li->m_childs[0]->m_parent);
+	}
+	copy->m_childs[0]->m_childs[0]->SetValue(std::string("three"));
+	EXPECT_EQ("<div id=\"a\"><ul><li>one</li><li>two</li></ul></div><div id=\"b\"><ul><li>three</li><li>two</li></ul></div>", dt.GetData(DataFormat::compact));
+
+	// a moved tag keeps its childs, linked to their new parent
+	Tag* moved = a->AddChild(std::move(*b));
+	ASSERT_NE(nullptr, moved);
+	EXPECT_EQ(a, moved->m_parent);
+	EXPECT_EQ(1, moved->m_childIndex);
+	ASSERT_EQ(1, moved->m_childs.size());
+	EXPECT_EQ(copy, moved->m_childs[0]);
+	EXPECT_EQ(moved, copy->m_parent);
+}
+
+bool IsSameTree(const Tag& tag, const CFlatTree::FlatTag& flat)
+{
+	if (tag.m_name != flat.GetName() || tag.m_value != flat.GetValue() ||
+		tag.m_attributes.size() != flat.GetAttributes().size() || tag.m_childs.size() != flat.GetChilds().size())
+		return false;
+	auto child = flat.GetChilds().begin();
+	for (const auto& it : tag.m_childs)
+	{
+		if (!IsSameTree(*it, *child++))
+			return false;
+	}
+	return true;
+}
+
+TEST(TestFlatTree, imbricatedTables)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/imbricated_tables.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	CFlatTree flat{ dt };
+	EXPECT_EQ(dt.GetTags().size(), flat.GetTags().size());
+	if (2 == flat.GetTags().size())				// doctype, html
+	{
+		auto html = *std::next(flat.GetTags().begin());
+		EXPECT_EQ("html", html.GetName());
+		EXPECT_EQ(2, html.GetChilds().size());	// head, body
+		EXPECT_TRUE(IsSameTree(*dt.GetTags().at(1), html));
+		EXPECT_EQ(html, (*html.GetChilds().begin()).GetParent());
+	}
+	EXPECT_NE(CFlatTree::npos, flat.FindNameId("table"));
+}
+
+TEST(TestFlatTree, snapshot)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	const std::filesystem::path path{ std::filesystem::temp_directory_path() / "dailymail.domtree" };
+	EXPECT_TRUE(CFlatTree{ dt }.SaveSnapshot(path));
+
+	CFlatTree flat{};
+	EXPECT_TRUE(flat.LoadSnapshot(path));
+	EXPECT_TRUE(flat.IsSnapshot());
+	const CFlatTree copy{ flat };
+	ASSERT_EQ(dt.GetTags().size(), copy.GetTags().size());
+	auto it = copy.GetTags().begin();
+	for (const auto& tag : dt.GetTags())
+		EXPECT_TRUE(IsSameTree(*tag, *it++));
+
+	std::string snapshot{};
+	StringSink sink{ snapshot };
+	flat.WriteSnapshot(sink);
+	EXPECT_EQ(std::filesystem::file_size(path), snapshot.size());
+
+	// a tree viewing a snapshot in memory keeps viewing it when copied or moved
+	CFlatTree view{};
+	EXPECT_TRUE(view.LoadSnapshotView(snapshot));
+	EXPECT_TRUE(view.IsSnapshot());
+	const CFlatTree viewCopy{ view };
+	CFlatTree viewMoved{ std::move(view) };
+	EXPECT_EQ(flat.GetCount(), viewCopy.GetCount());
+	EXPECT_EQ(flat.GetCount(), viewMoved.GetCount());
+	EXPECT_TRUE(viewMoved.IsSnapshot());
+	EXPECT_EQ(0, view.GetCount());
+	EXPECT_TRUE(IsSameTree(*dt.GetTags().front(), *viewCopy.GetTags().begin()));
+	CFlatTree viewAssigned{ dt };
+	viewAssigned = viewCopy;
+	EXPECT_EQ(flat.GetCount(), viewAssigned.GetCount());
+	snapshot[4] = 2;	// version
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << snapshot;
+	EXPECT_FALSE(flat.LoadSnapshot(path));
+	EXPECT_EQ(0, flat.GetCount());
+	std::filesystem::remove(path);
+}
+
+TEST(TestFlatTree, snapshotValidation)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<div id=\"a\"><p>x</p><p>y</p></div>"));
+	const CFlatTree flat{ dt };
+	std::string snapshot{};
+	StringSink sink{ snapshot };
+	flat.WriteSnapshot(sink);
+	CFlatTree loaded{};
+	EXPECT_TRUE(loaded.LoadSnapshotView(snapshot));
+	ASSERT_EQ(5, loaded.GetCount());	// div, p, x, p, y
+
+	// the offsets of the columns, each padded to 8 bytes
+	const auto padded = [](const size_t size) { return (size + 7) / 8 * 8; };
+	const size_t nodes{ flat.GetCount() };
+	const size_t parent{ sizeof(CFlatTree::SnapshotHeader) };
+	const size_t firstChild{ parent + padded(nodes * sizeof(uint32_t)) };
+	const size_t nextSibling{ firstChild + padded(nodes * sizeof(uint32_t)) };
+	const size_t nameId{ nextSibling + padded(nodes * sizeof(uint32_t)) };
+	const size_t value{ nameId + padded(nodes * sizeof(uint32_t)) };
+	const size_t attributeRange{ value + padded(nodes * sizeof(CFlatTree::Range)) };
+	const size_t attributes{ attributeRange + padded(nodes * sizeof(CFlatTree::Range)) };
+	const size_t names{ attributes + padded(sizeof(CFlatTree::FlatAttribute)) };
+	// a snapshot with the uint32_t at offset replaced is refused, and leaves the tree empty
+	const auto isLoaded = [&snapshot, &loaded](const size_t offset, const uint32_t number)
+		{
+			std::string corrupt{ snapshot };
+			std::memcpy(corrupt.data() + offset, &number, sizeof(number));
+			const bool result{ loaded.LoadSnapshotView(corrupt) };
+			EXPECT_EQ(result ? 5 : 0, loaded.GetCount());
+			return result;
+		};
+	EXPECT_TRUE(isLoaded(parent, CFlatTree::npos));
+	EXPECT_FALSE(isLoaded(parent, 0));									// a root links to itself
+	EXPECT_FALSE(isLoaded(parent + 1 * sizeof(uint32_t), 7));			// no such node
+	EXPECT_FALSE(isLoaded(parent + 2 * sizeof(uint32_t), 3));			// a later parent
+	EXPECT_FALSE(isLoaded(firstChild, CFlatTree::npos));				// the childs aren't reached
+	EXPECT_FALSE(isLoaded(firstChild, 3));								// the second p is linked twice
+	EXPECT_FALSE(isLoaded(nextSibling + 3 * sizeof(uint32_t), 1));		// a cycle
+	EXPECT_FALSE(isLoaded(nextSibling + 1 * sizeof(uint32_t), 2));		// a sibling with another parent
+	EXPECT_FALSE(isLoaded(nameId, 1000));
+	EXPECT_FALSE(isLoaded(value + 2 * sizeof(CFlatTree::Range), 1000));	// offset of the text x
+	EXPECT_FALSE(isLoaded(value + 2 * sizeof(CFlatTree::Range) + sizeof(uint32_t), CFlatTree::npos));
+	EXPECT_FALSE(isLoaded(attributeRange + sizeof(uint32_t), 2));		// the div has one attribute
+	EXPECT_FALSE(isLoaded(attributes + sizeof(uint32_t), 1000));		// length of the key
+	EXPECT_FALSE(isLoaded(names + sizeof(CFlatTree::Range), CFlatTree::npos));
+	EXPECT_TRUE(isLoaded(nameId, 0));
+}
+
+TEST(TestFlatTree, viewFlatTree)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	std::string snapshot{};
+	StringSink sink{ snapshot };
+	CFlatTree{ dt }.WriteSnapshot(sink);
+	CFlatTree flat{};
+	ASSERT_TRUE(flat.LoadSnapshotView(snapshot));
+
+	// the tags of the snapshot are written, walked and queried like the parsed ones
+	CDomTree view{};
+	view.ViewFlatTree(flat);
+	EXPECT_EQ(dt.GetData(), view.GetData());
+	EXPECT_EQ(std::ranges::distance(dt.Descendants()), std::ranges::distance(view.Descendants()));
+	const auto outer = [](const std::vector<Tag*>& tags)
+		{
+			std::string out{};
+			for (const Tag* tag : tags)
+				out += tag->GetOuterHtml();
+			return out;
+		};
+	EXPECT_FALSE(CSelector{ "div > a[href]" }.Select(view).empty());
+	for (const char* selector : { "div > a[href]", "ul li + li", "p ~ div", "[class~=\"article\"] img", "li:nth-child(2n)" })
+	{
+		const CSelector compiled{ selector };
+		EXPECT_EQ(outer(compiled.Select(dt)), outer(compiled.Select(view))) << selector;
+	}
+	for (const char* path : { "//div[@class]/a", "//ul/li[last()]", "//head/meta[2]" })
+	{
+		const CXPath compiled{ path };
+		EXPECT_EQ(outer(compiled.Select(dt)), outer(compiled.Select(view))) << path;
+	}
+	EXPECT_EQ(dt.GetElementsByTagId(TagId::a).size(), view.GetElementsByTagId(TagId::a).size());
+	EXPECT_EQ(dt.GetElementsByClassName("article").size(), view.GetElementsByClassName("article").size());
+}
+
+TEST(TestScan, findFirstOf)
+{
+	const std::string text(std::string(70, 'a') + "<" + std::string(40, ' ') + "b");
+	for (size_t pos = 0; pos <= 70; ++pos)
+		EXPECT_EQ(70, FindFirstOf<'<'>(text, pos));
+	EXPECT_EQ(text.size(), FindFirstOf<'<'>(text, 71));
+	EXPECT_EQ(text.size() + 1, FindFirstOf<'<'>(text, text.size() + 1));
+	EXPECT_EQ(70, (FindFirstOf<'>', '<', '='>(text, 3)));
+	EXPECT_EQ(text.size() - 1, (FindFirstNotOf<' ', '\t'>(text, 71)));
+	EXPECT_EQ(5, (FindFirstNotOf<' ', '\t'>(text, 5)));
+	EXPECT_EQ(text.size() - 1, (FindFirstOf<'b', 'c'>(text, 0)));
+	EXPECT_EQ(8, (FindFirstOf<'b', 'c'>(text.substr(0, 8), 0)));
+}
+
+TEST(TestTagId, atoms)
+{
+	static_assert(TagId::table == GetTagId("table"));
+	EXPECT_EQ(TagId::br, GetTagId("BR"));
+	EXPECT_EQ(TagId::unknown, GetTagId("tables"));
+	EXPECT_EQ(TagId::unknown, GetTagId("my-widget"));
+	EXPECT_TRUE(GetTagTraits(GetTagId("img")).m_selfClosing);
+	EXPECT_FALSE(GetTagTraits(GetTagId("div")).m_selfClosing);
+	for (size_t id = 1; id < tag_count; ++id)
+		EXPECT_EQ(static_cast<TagId>(id), GetTagId(tag_names[id]));
+
+	CDomTree dt{};
+	dt.Parse(std::string("<HTML><Body><P>abc<BR></P></Body></HTML>"));
+	EXPECT_EQ(1, dt.GetTags().size());
+	if (1 == dt.GetTags().size())
+	{
+		EXPECT_EQ(TagId::html, dt.GetTags().at(0)->m_id);
+		EXPECT_EQ("html", dt.GetTags().at(0)->m_name);
+	}
+	EXPECT_EQ("<html>\n\t<body>\n\t\t<p>\n\t\t\tabc\n\t\t\t<br/>\n\t\t</p>\n\t</body>\n</html>\n", dt.GetData());
+}
+
+TEST(TestStream, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(html_file);
+	for (const size_t chunk : { 1000, 4096, 65536 })
+	{
+		CDomTree dtStream{};
+		for (size_t pos = 0; pos < html_file.size(); pos += chunk)
+			dtStream.Feed(std::string_view(html_file).substr(pos, chunk));
+		dtStream.Finish();
+		EXPECT_EQ(dt.GetData(), dtStream.GetData());
+		EXPECT_EQ(2, dtStream.GetTags().size());
+	}
+}
+
+TEST(TestStream, splitTokens)
+{
+	const std::string html_file{ "<!DOCTYPE html><html><head><!-- a > b --><style>p > a { }</style></head>"
+		"<body><a href=\"x>y\" class='z'>link</a><script>if (a < b) { }</script><p>text</body></html>" };
+	CDomTree dt{};
+	dt.Parse(html_file);
+	CDomTree dtStream{};
+	for (const char c : html_file)
+		dtStream.Feed(std::string_view(&c, 1));
+	dtStream.Finish();
+	EXPECT_EQ(dt.GetData(), dtStream.GetData());
+}
+
+struct EventLog
+{
+	void OnOpenTag(std::string_view name, TagId) { m_log += "<" + std::string(name); }
+	void OnAttribute(std::string_view key, std::string_view value, char) { m_log += " " + std::string(key) + "=" + std::string(value); }
+	void OnCloseTag(std::string_view name, TagId) { m_log += "</" + std::string(name) + ">"; }
+	void OnText(std::string_view text) { m_log += "[" + std::string(text) + "]"; }
+	void OnComment(std::string_view text) { m_log += "{" + std::string(text) + "}"; }
+	void OnDoctype(std::string_view text) { m_log += "(" + std::string(text) + ")"; }
+	std::string m_log{};
+};
+
+struct LinkCounter
+{
+	void OnOpenTag(std::string_view, TagId id) { m_a = (TagId::a == id); }
+	void OnAttribute(std::string_view key, std::string_view, char) { m_links += (m_a && "href" == key); }
+	size_t m_links{};
+	bool m_a{ false };
+};
+
+size_t CountLinks(const std::vector<Tag*>& tags)
+{
+	size_t links{};
+	for (const auto& tag : tags)
+	{
+		if (TagId::a == tag->m_id)
+			links += std::count_if(tag->m_attributes.begin(), tag->m_attributes.end(), [](const Attribute& attr) { return "href" == attr.m_key; });
+		links += CountLinks(tag->m_childs);
+	}
+	return links;
+}
+
+TEST(TestTokenizer, events)
+{
+	EventLog log{};
+	CTokenizer<EventLog> tokenizer{ log };
+	tokenizer.Parse("<!DOCTYPE html><html><!-- note --><body class='x' hidden><p>a<br>b</p>"
+		"<script> if (a < b) { }</script><img src=\"i.png\"/></body></html>");
+	EXPECT_EQ("(!DOCTYPE html)<html{ note }<body class=x hidden=<p[a]<br</br>[b]</p>"
+		"<script[if (a < b) { }]</script><img src=i.png</img></body></html>", log.m_log);
+}
+
+TEST(TestTokenizer, links)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	LinkCounter counter{};
+	CTokenizer<LinkCounter> tokenizer{ counter };
+	tokenizer.Parse(html_file);
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	EXPECT_LT(0, counter.m_links);
+	EXPECT_EQ(CountLinks(dt.GetTags()), counter.m_links);
+}
+
+TEST(TestFile, dailymail)
+{
+	const std::string path{ std::filesystem::current_path().generic_string() + "/html/dailymail.html" };
+	std::ifstream ifs(path);
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	CDomTree dtFile{ ParseOptions{ .m_zeroCopy = true } };
+	EXPECT_TRUE(dtFile.ParseFile(path));
+	EXPECT_EQ(dt.GetData(), dtFile.GetData());
+	CDomTree dtMoved{ std::move(dtFile) };
+	EXPECT_EQ(dt.GetData(), dtMoved.GetData());
+	EXPECT_FALSE(CDomTree{}.ParseFile(path + ".missing"));
+}
+
+TEST(TestBatch, corpus)
+{
+	std::vector<std::filesystem::path> files{};
+	for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::current_path() / "html"))
+		files.push_back(entry.path());
+	std::vector<std::string> documents{};
+	std::vector<std::string> expected{};
+	for (const auto& file : files)
+	{
+		std::ifstream ifs(file);
+		documents.emplace_back((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+		CDomTree dt{};
+		dt.Parse(documents.back());
+		expected.push_back(dt.GetData());
+	}
+
+	CBatchParser batch{ ParseOptions{ .m_zeroCopy = true }, 4 };
+	std::vector<std::string> data(documents.size());
+	batch.ParseBatch(documents, [&data](const size_t index, const CDomTree& tree) { data[index] = tree.GetData(); });
+	EXPECT_EQ(expected, data);
+	std::fill(data.begin(), data.end(), std::string{});
+	batch.ParseBatch(files, [&data](const size_t index, const CDomTree& tree) { data[index] = tree.GetData(); });
+	EXPECT_EQ(expected, data);
+
+	const std::vector<CDomTree> trees{ batch.ParseBatch(std::move(documents)) };
+	ASSERT_EQ(expected.size(), trees.size());
+	for (size_t i = 0; i < trees.size(); ++i)
+		EXPECT_EQ(expected[i], trees[i].GetData());
+}
+
+TEST(TestWriter, sinks)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	const std::string data{ dt.GetData() };
+
+	std::ostringstream stream{};
+	StreamSink streamSink{ stream };
+	dt.WriteData(streamSink);
+	EXPECT_EQ(data, stream.str());
+
+	std::string blocks{};
+	size_t writes{};
+	CallbackSink callbackSink{ [&](std::string_view text)
+		{
+			writes++;
+			blocks += text;
+		} };
+	dt.WriteData(callbackSink);
+	EXPECT_EQ(data, blocks);
+	EXPECT_GT(data.size() / 2048, writes);
+}
+
+TEST(TestWriter, compact)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<!DOCTYPE html><html><!-- note --><body class='x'><p>abc  <br>def</p>\n<div>\n</div></body></html>"));
+	EXPECT_EQ("<!DOCTYPE html><html><!-- note --><body class='x'><p>abc<br/>def</p><div></div></body></html>", dt.GetData(DataFormat::compact));
+
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	dt = CDomTree{};
+	dt.Parse(std::move(html_file));
+	const std::string compact{ dt.GetData(DataFormat::compact) };
+	CountingSink counter{};
+	dt.WriteData(counter, DataFormat::compact);
+	EXPECT_EQ(compact.size(), counter.m_size);
+	EXPECT_GT(dt.GetData().size(), compact.size());
+
+	CDomTree dtCompact{};
+	dtCompact.Parse(compact);
+	EXPECT_EQ(dt.GetData(), dtCompact.GetData());
+}
+
+TEST(TestWriter, outerInnerHtml)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<html><body><table id=\"t\"><tr><td>a</td><td>b<br></td></tr></table><p>abc</p></body></html>"));
+	ASSERT_EQ(1, dt.GetTags().size());
+	const Tag& html = *dt.GetTags().front();
+	EXPECT_EQ(dt.GetData(), html.GetOuterHtml(DataFormat::indented) + "\n");
+	EXPECT_EQ(dt.GetData(DataFormat::compact), html.GetOuterHtml());
+
+	const Tag& table = *html.m_childs.at(0)->m_childs.at(0);
+	EXPECT_EQ("<table id=\"t\"><tr><td>a</td><td>b<br/></td></tr></table>", table.GetOuterHtml());
+	EXPECT_EQ("<tr><td>a</td><td>b<br/></td></tr>", table.GetInnerHtml());
+	EXPECT_EQ("<tr>\n\t<td>a</td>\n\t<td>\n\t\tb\n\t\t<br/>\n\t</td>\n</tr>", table.GetInnerHtml(DataFormat::indented));
+	EXPECT_EQ("abc", html.m_childs.at(0)->m_childs.at(1)->GetInnerHtml());
+}
+
+std::string SelectedNames(const std::vector<Tag*>& tags)
+{
+	std::string names{};
+	for (const Tag* tag : tags)
+	{
+		names += names.empty() ? "" : " ";
+		names += tag->m_name;
+		for (const auto& attr : tag->m_attributes)
+		{
+			if ("id" == attr.m_key)
+				names += "#" + attr.m_value.str();
+		}
+	}
+	return names;
+}
+
+std::string SelectedNames(const CDomTree& dt, std::string_view selector)
+{
+	return SelectedNames(CSelector{ selector }.Select(dt));
+}
+
+TEST(TestSelector, combinators)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<html><body><div id=\"main\" class=\"box wide\"><p id=\"p1\">a</p><p id=\"p2\" lang=\"en-US\">b</p>"
+		"<!-- c --><span id=\"s1\">c</span><p id=\"p3\">d<a id=\"a1\" href=\"https://x.com/page.html\">e</a></p></div>"
+		"<ul><li id=\"l1\">1</li><li id=\"l2\">2</li><li id=\"l3\">3</li><li id=\"l4\">4</li><li id=\"l5\">5</li></ul></body></html>"));
+	EXPECT_EQ("p#p1 p#p2 p#p3", SelectedNames(dt, "p"));
+	EXPECT_EQ("div#main", SelectedNames(dt, "#main"));
+	EXPECT_EQ("div#main", SelectedNames(dt, "DIV.box.wide"));
+	EXPECT_EQ("", SelectedNames(dt, ".box.narrow"));
+	EXPECT_EQ("a#a1", SelectedNames(dt, "body a"));
+	EXPECT_EQ("", SelectedNames(dt, "div > a"));
+	EXPECT_EQ("a#a1", SelectedNames(dt, "div > p > a"));
+	EXPECT_EQ("span#s1", SelectedNames(dt, "p + span"));
+	EXPECT_EQ("p#p2 span#s1 p#p3", SelectedNames(dt, "#p1 ~ *"));
+	EXPECT_EQ("p#p2", SelectedNames(dt, "[lang|=en]"));
+	EXPECT_EQ("a#a1", SelectedNames(dt, "a[href^='https://'][href$=\".html\"][href*=x]"));
+	EXPECT_EQ("li#l1 li#l3 li#l5", SelectedNames(dt, "li:nth-child(odd)"));
+	EXPECT_EQ("li#l2 li#l4", SelectedNames(dt, "li:nth-child(2n)"));
+	EXPECT_EQ("li#l1 li#l2 li#l3", SelectedNames(dt, "li:nth-child(-n + 3)"));
+	EXPECT_EQ("li#l5", SelectedNames(dt, "ul > :last-child"));
+	EXPECT_EQ("p#p3 li#l4", SelectedNames(dt, "p:nth-child(4), li:nth-last-child(2)"));
+	EXPECT_EQ("a#a1", SelectedNames(dt, "p:only-child, a:only-child"));
+	EXPECT_FALSE(CSelector{ "p >" }.IsValid());
+	EXPECT_FALSE(CSelector{ "p[lang" }.IsValid());
+	EXPECT_FALSE(CSelector{ "li:nth-child(2x)" }.IsValid());
+	EXPECT_EQ(nullptr, CSelector{ "p >" }.SelectFirst(dt));
+}
+
+TEST(TestSelector, wideSiblings)
+{
+	std::string html{ "<ul>" };
+	for (int i = 0; i < 3000; ++i)
+		html += "<li>" + std::to_string(i) + "</li>text";	// the texts between the items aren't counted
+	html += "</ul>";
+	CDomTree dt{};
+	dt.Parse(html);
+	EXPECT_EQ(1000, CSelector{ "li:nth-child(3n+1)" }.Select(dt).size());
+	EXPECT_EQ(2999, CSelector{ "li + li" }.Select(dt).size());
+	EXPECT_EQ(2999, CSelector{ "li ~ li" }.Select(dt).size());
+	const std::vector<Tag*> last{ CSelector{ "li:nth-last-child(2)" }.Select(dt) };
+	ASSERT_EQ(1, last.size());
+	EXPECT_EQ("2998", last.front()->m_childs.front()->m_value);
+
+	// a single tag is matched without the walk cache, the same way
+	const CSelector nth{ "li:nth-child(3n+1)" };
+	const std::vector<Tag*>& items{ dt.GetTags().front()->m_childs };
+	EXPECT_EQ(1000, std::count_if(items.begin(), items.end(), [&nth](const Tag* tag) { return nth.Match(*tag); }));
+}
+
+TEST(TestSelector, deepNesting)
+{
+	constexpr size_t depth{ 20000 };
+	std::string html{ "<section>" };
+	for (size_t i = 0; i < depth; ++i)
+		html += "<div>";
+	for (size_t i = 0; i < depth; ++i)
+		html += "</div>";
+	html += "</section>";
+	CDomTree dt{};
+	dt.Parse(html);
+	// every div looks for a section above it only once
+	EXPECT_EQ(depth - 1, CSelector{ "section div div" }.Select(dt).size());
+	EXPECT_EQ(0, CSelector{ "p div div" }.Select(dt).size());
+	EXPECT_EQ(depth - 1, CSelector{ "section div > div:only-child" }.Select(dt).size());
+
+	// a single tag stops at the first parent which fails all the others
+	const Tag* deepest{ dt.GetTags().front() };
+	while (!deepest->m_childs.empty())
+		deepest = deepest->m_childs.front();
+	EXPECT_TRUE(CSelector{ "section div div" }.Match(*deepest));
+	EXPECT_FALSE(CSelector{ "p div div" }.Match(*deepest));
+}
+
+TEST(TestSelector, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	const CSelector links{ "a[href]" };
+	EXPECT_EQ(CountLinks(dt.GetTags()), links.Select(dt).size());
+	EXPECT_EQ(links.Select(dt).front(), links.SelectFirst(dt));
+}
+
+TEST(TestTagIndex, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(html_file);
+	CDomTree dtIndexed{ ParseOptions{ .m_indexTags = true } };
+	dtIndexed.Parse(html_file);
+	CDomTree dtStream{ ParseOptions{ .m_indexTags = true } };
+	for (size_t pos = 0; pos < html_file.size(); pos += 4096)
+		dtStream.Feed(std::string_view(html_file).substr(pos, 4096));
+	dtStream.Finish();
+
+	for (const char* name : { "a", "table", "meta", "div", "script" })
+	{
+		const std::vector<Tag*> expected{ CSelector{ name }.Select(dt) };
+		const auto tags = dt.GetElementsByTagName(name);
+		EXPECT_TRUE(std::equal(expected.begin(), expected.end(), tags.begin(), tags.end()));
+		EXPECT_EQ(expected.size(), dtIndexed.GetElementsByTagName(name).size());
+		EXPECT_EQ(expected.size(), dtStream.GetElementsByTagId(GetTagId(name)).size());
+	}
+	EXPECT_EQ(dt.GetElementsByTagName("a").size(), dt.GetElementsByTagName("A").size());
+
+	CDomTree dtCustom{ ParseOptions{ .m_indexTags = true } };
+	dtCustom.Parse(std::string("<html><body><my-widget>a</my-widget><div><My-Widget/></div></body></html>"));
+	EXPECT_EQ(2, dtCustom.GetElementsByTagName("my-widget").size());
+	EXPECT_EQ(0, dtCustom.GetElementsByTagName("other-widget").size());
+	EXPECT_EQ(1, dtCustom.GetElementsByTagName("body").size());
+}
+
+TEST(TestAttributeIndex, mutation)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<html><body><div id=\"main\" class=\"box  wide\"><p class=\"box\">a</p><p ID=\"x\">b</p></div></body></html>"));
+	ASSERT_NE(nullptr, dt.GetElementById("main"));
+	EXPECT_EQ("div", dt.GetElementById("main")->m_name);
+	EXPECT_EQ("p", dt.GetElementById("x")->m_name);
+	EXPECT_EQ(nullptr, dt.GetElementById("none"));
+	EXPECT_EQ(2, dt.GetElementsByClassName("box").size());
+	EXPECT_EQ(1, dt.GetElementsByClassName("wide").size());
+	EXPECT_EQ(0, dt.GetElementsByClassName("box wide").size());
+	EXPECT_EQ(2, dt.GetElementsByTagName("p").size());
+
+	Tag* div = dt.GetElementById("main");
+	Tag* span = div->AddChild(Tag{ "span", std::vector<Attribute>{ { "id", "new" }, { "class", "box" } } });
+	EXPECT_EQ(span, dt.GetElementById("new"));
+	EXPECT_EQ(3, dt.GetElementsByClassName("box").size());
+	EXPECT_EQ(span, dt.GetElementsByClassName("box").back());
+
+	span->SetName("p");
+	EXPECT_EQ(3, dt.GetElementsByTagName("p").size());
+	EXPECT_EQ(0, dt.GetElementsByTagName("span").size());
+	span->AddAttributes({ { "class", "late" } });
+	EXPECT_EQ(span, dt.GetElementsByClassName("late").front());
+}
+
+TEST(TestAttributeIndex, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	for (const char* name : { "article", "link-text", "puff", "nav" })
+	{
+		const std::vector<Tag*> expected{ CSelector{ std::string(".") + name }.Select(dt) };
+		const auto tags = dt.GetElementsByClassName(name);
+		EXPECT_TRUE(std::equal(expected.begin(), expected.end(), tags.begin(), tags.end()));
+	}
+	// with duplicated ids the first tag in document order wins
+	for (Tag* tag : CSelector{ "[id]" }.Select(dt))
+	{
+		const auto id = std::find_if(tag->m_attributes.begin(), tag->m_attributes.end(),
+			[](const Attribute& attribute) { return attribute.m_key == "id"; });
+		const Tag* found = dt.GetElementById(id->m_value.view());
+		ASSERT_NE(nullptr, found);
+		EXPECT_EQ(CSelector{ "[id=\"" + std::string(id->m_value.view()) + "\"]" }.SelectFirst(dt), found);
+	}
+}
+
+TEST(TestXPath, axes)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<html><body><table id=\"t1\" class=\"x\"><tr id=\"r1\"><td id=\"c1\">a</td><td id=\"c2\">b</td></tr>"
+		"<tr id=\"r2\"><td id=\"c3\">c</td><td id=\"c4\"> d </td><td id=\"c5\">e</td></tr></table>"
+		"<table id=\"t2\"><tr id=\"r3\"><td id=\"c6\"><a id=\"a1\" href=\"https://x.com\">f</a></td></tr></table>"
+		"<!-- g --><p id=\"p1\">h</p></body></html>"));
+	const auto names = [&dt](std::string_view path) { return SelectedNames(CXPath{ path }.Select(dt)); };
+	EXPECT_EQ("td#c3 td#c4 td#c5", names("//table[@class='x']/tr[2]/td"));
+	EXPECT_EQ("td#c3 td#c4 td#c5", names("//TABLE[@class = \"x\"]/TR[2]/td"));
+	EXPECT_EQ("td#c1 td#c3 td#c6", names("//tr/td[1]"));
+	EXPECT_EQ("td#c2 td#c5 td#c6", names("//tr/td[last()]"));
+	EXPECT_EQ("td#c1 td#c4", names("//tr/td[last() - 1]"));
+	EXPECT_EQ("td#c2 td#c5", names("//tr/td[position() > 1][last()]"));
+	EXPECT_EQ("td#c2", names("/html/body/table[1]/descendant::td[2]"));
+	EXPECT_EQ("td#c6", names("//table[2]//td"));
+	EXPECT_EQ("td#c4 td#c5", names("//td[@id='c3']/following-sibling::td"));
+	EXPECT_EQ("td#c5", names("//td[@id='c3']/following-sibling::td[2]"));
+	EXPECT_EQ("tr#r3", names("//a/../.."));
+	EXPECT_EQ("table#t2", names("//a/parent::td/parent::*/parent::table"));
+	EXPECT_EQ("td#c4", names("//td[text() = 'd']"));
+	EXPECT_EQ("td#c1 td#c2 td#c3 td#c5 td#c6", names("//td[not(text() = 'd')]"));
+	EXPECT_EQ("td#c2 td#c4", names("//td[@id = 'c2' or @id = 'c4' and starts-with(text(), 'd')]"));
+	EXPECT_EQ("a#a1", names("//a[contains(@href, 'x.com') and @href != 'x']"));
+	EXPECT_EQ("tr#r1 tr#r2", names("//table[@id='t1']/tr | //p[@id='none']"));
+	EXPECT_EQ("p#p1", names("//body/*[last()]"));
+	EXPECT_EQ(5, CXPath{ "//body/table[1]//text()" }.Select(dt).size());
+	EXPECT_EQ(1, CXPath{ "//comment()" }.Select(dt).size());
+	EXPECT_EQ("table#t1 table#t2", names("//body/node()[position() <= 2]"));
+
+	// relative paths start at the root tag
+	Tag& table = *dt.GetTags().front()->m_childs.front()->m_childs.front();
+	EXPECT_EQ("td#c3 td#c4 td#c5", SelectedNames(CXPath{ "tr[2]/td" }.Select(table)));
+	EXPECT_EQ("table#t1", SelectedNames(CXPath{ "/table" }.Select(table)));
+	EXPECT_EQ("", SelectedNames(CXPath{ "//a | ../p" }.Select(table)));
+	EXPECT_EQ("tr#r1", SelectedNames({ CXPath{ ".//td/.." }.SelectFirst(table) }));
+
+	EXPECT_FALSE(CXPath{ "//td[" }.IsValid());
+	EXPECT_FALSE(CXPath{ "//td/" }.IsValid());
+	EXPECT_FALSE(CXPath{ "ancestor::td" }.IsValid());
+	EXPECT_FALSE(CXPath{ "//td[@id > 'x']" }.IsValid());
+	EXPECT_EQ(nullptr, CXPath{ "//td[" }.SelectFirst(dt));
+}
+
+TEST(TestXPath, wideSiblings)
+{
+	std::string html{ "<ul>" };
+	for (int i = 0; i < 3000; ++i)
+		html += "<li>" + std::to_string(i) + "</li>";
+	html += "</ul>";
+	CDomTree dt{};
+	dt.Parse(html);
+	const auto values = [&dt](std::string_view path)
+	{
+		std::string values{};
+		for (const Tag* tag : CXPath{ path }.Select(dt))
+			values += (values.empty() ? "" : " ") + tag->m_childs.front()->m_value.str();
+		return values;
+	};
+	EXPECT_EQ("1", values("//li[1]/following-sibling::li[1]"));
+	EXPECT_EQ("2999", values("//li[1]/following-sibling::li[last()]"));
+	EXPECT_EQ("2997 2998 2999", values("//ul/li[position() > 2997]"));
+	EXPECT_EQ("2999", values("//li[last()]"));
+	EXPECT_EQ("1499", values("/descendant::li[1500]"));
+	EXPECT_EQ(2999, CXPath{ "//li/following-sibling::li" }.Select(dt).size());
+	EXPECT_EQ(2998, CXPath{ "//li/following-sibling::li[2]" }.Select(dt).size());
+}
+
+TEST(TestXPath, deepNesting)
+{
+	constexpr size_t depth{ 20000 };
+	std::string html{ "<section>" };
+	for (size_t i = 0; i < depth; ++i)
+		html += "<div>";
+	for (size_t i = 0; i < depth; ++i)
+		html += "</div>";
+	html += "</section>";
+	CDomTree dt{};
+	dt.Parse(html);
+	// every div tries every parent as a context only once
+	EXPECT_EQ(depth - 1, CXPath{ "//section//div//div" }.Select(dt).size());
+	EXPECT_EQ(0, CXPath{ "//p//div//div" }.Select(dt).size());
+	EXPECT_EQ(depth, CXPath{ "//div[1]" }.Select(dt).size());
+	EXPECT_EQ(1, CXPath{ "//section/descendant::div[last()]" }.Select(dt).size());
+}
+
+TEST(TestXPath, dailymail)
+{
+	std::ifstream ifs(std::filesystem::current_path().generic_string() + "/html/dailymail.html");
+	std::string html_file((std::istreambuf_iterator<char>(ifs)),
+		(std::istreambuf_iterator<char>()));
+	CDomTree dt{};
+	dt.Parse(std::move(html_file));
+	EXPECT_EQ(CountLinks(dt.GetTags()), CXPath{ "//a[@href]" }.Select(dt).size());
+	EXPECT_EQ(CSelector{ "div > ul > li:first-child a[href]" }.Select(dt), CXPath{ "//div/ul/li[1]//a[@href]" }.Select(dt));
+	EXPECT_EQ(CSelector{ "ul > :last-child" }.Select(dt), CXPath{ "//ul/*[last()]" }.Select(dt));
+}
+
+TEST(TestAttributes, lookup)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<div CLASS=\"a b\" data-X=\"1\" id=\"d1\"><svg viewBox=\"0 0 8 8\"></svg>"
+		"<img src=\"1.png\" alt=\"\" width=\"8\" height=\"8\" title=\"t\" loading=\"lazy\"></div>"));
+	Tag* div = dt.GetElementById("d1");
+	ASSERT_NE(nullptr, div);
+	EXPECT_EQ("a b", div->GetAttribute("class"));
+	EXPECT_EQ("a b", div->GetAttribute("Class"));
+	EXPECT_EQ("a b", div->GetAttribute(AttributeId::class_));
+	EXPECT_EQ("1", div->GetAttribute("DATA-x"));
+	EXPECT_TRUE(div->HasAttribute("data-x"));
+	EXPECT_FALSE(div->HasAttribute(AttributeId::href));
+	EXPECT_EQ("", div->GetAttribute("href"));
+	// known keys are interned, the others are kept as written
+	EXPECT_EQ(attribute_names[static_cast<size_t>(AttributeId::class_)].data(), div->m_attributes[0].m_key.data());
+	EXPECT_EQ("data-X", div->m_attributes[1].m_key);
+	EXPECT_EQ("viewBox", div->m_childs.at(0)->m_attributes.front().m_key);
+
+	Tag* img = div->m_childs.at(1);
+	EXPECT_EQ(6, img->m_attributes.size());
+	EXPECT_TRUE(img->HasAttribute(AttributeId::loading));
+	EXPECT_EQ("", img->GetAttribute("alt"));
+	EXPECT_TRUE(img->HasAttribute("alt"));
+
+	div->SetAttribute("id", "d2");
+	div->SetAttribute("Role", "main");
+	EXPECT_EQ(nullptr, dt.GetElementById("d1"));
+	EXPECT_EQ(div, dt.GetElementById("d2"));
+	EXPECT_EQ("main", div->GetAttribute(AttributeId::role));
+	EXPECT_EQ("role", div->m_attributes.back().m_key);
+	EXPECT_EQ("<div class=\"a b\" data-X=\"1\" id=\"d2\" role=\"main\">", div->GetOuterHtml().substr(0, 48));
+
+	// copies and moves of tags with inline and heap attributes
+	const Tag copy{ *img };
+	Tag moved{ std::move(*img) };
+	EXPECT_EQ("t", copy.GetAttribute("title"));
+	EXPECT_EQ("t", moved.GetAttribute("title"));
+	EXPECT_TRUE(img->m_attributes.empty());
+	Tag small{ "p", { { "id", "x" } } };
+	Tag other{ std::move(small) };
+	EXPECT_EQ("x", other.GetAttribute("id"));
+	other = copy;
+	EXPECT_EQ("lazy", other.GetAttribute("loading"));
+	other = Tag{ "p", { { "lang", "en" } } };
+	EXPECT_EQ(1, other.m_attributes.size());
+	EXPECT_EQ("en", other.GetAttribute(AttributeId::lang));
+}
+
+TEST(TestAttributes, lazyReparse)
+{
+	// the pending attributes of the previous documents are parsed from their kept buffers
+	CDomTree dt{ ParseOptions{ .m_lazyAttributes = true } };
+	dt.Parse(std::string("<div id=\"first\" class=\"a\">1</div>"));
+	dt.Parse(std::string("<div id=\"second\" class=\"b\">2</div>"));
+	ASSERT_EQ(2, dt.GetTags().size());
+	const Tag* first = dt.GetTags().at(0);
+	EXPECT_TRUE(first->m_attributes.IsPending());
+	EXPECT_EQ("a", first->GetAttribute(AttributeId::class_));
+	EXPECT_EQ(dt.GetTags().at(1), dt.GetElementById("second"));
+
+	// a copy has its own attributes
+	Tag copy{ *dt.GetTags().at(1) };
+	dt.Clear();
+	EXPECT_FALSE(copy.m_attributes.IsPending());
+	EXPECT_EQ("b", copy.GetAttribute("class"));
+}
+
+TEST(TestIterators, order)
+{
+	CDomTree dt{};
+	dt.Parse(std::string("<!DOCTYPE html><html><body><div id=\"d1\"><p id=\"p1\">a</p><p id=\"p2\">b<span id=\"s1\">c</span></p></div>"
+		"<ul id=\"u1\"><li id=\"l1\">1</li><li id=\"l2\">2</li><li id=\"l3\">3</li></ul></body></html>"));
+	const auto elements = [](auto&& range)
+	{
+		std::vector<Tag*> tags{};
+		std::ranges::copy(range | std::views::filter([](const Tag* tag) { return nullptr != tag->FindAttribute(AttributeId::id); }), std::back_inserter(tags));
+		return SelectedNames(tags);
+	};
+	EXPECT_EQ("div#d1 p#p1 p#p2 span#s1 ul#u1 li#l1 li#l2 li#l3", elements(dt.Descendants()));
+	EXPECT_EQ("p#p1 span#s1 p#p2 div#d1 li#l1 li#l2 li#l3 ul#u1", elements(dt.DescendantsPostOrder()));
+	std::vector<Tag*> tags{};
+	std::ranges::copy(dt.Descendants() | std::views::filter([](const Tag* tag) { return IsElement(*tag); }), std::back_inserter(tags));
+	EXPECT_EQ(CSelector{ "*" }.Select(dt), tags);
+
+	Tag* div = dt.GetElementById("d1");
+	EXPECT_EQ("p#p1 p#p2 span#s1", elements(div->Descendants()));
+	EXPECT_EQ("p#p1 span#s1 p#p2", elements(div->DescendantsPostOrder()));
+	EXPECT_EQ(2, std::ranges::distance(div->Childs()));
+	EXPECT_EQ("p#p2 div#d1 body html", SelectedNames(std::vector<Tag*>(dt.GetElementById("s1")->Ancestors().begin(), dt.GetElementById("s1")->Ancestors().end())));
+	EXPECT_EQ("li#l2 li#l3", elements(dt.GetElementById("l1")->FollowingSiblings()));
+	EXPECT_EQ("ul#u1", elements(div->FollowingSiblings()));
+	EXPECT_TRUE(dt.GetElementById("l3")->FollowingSiblings().empty());
+	EXPECT_TRUE(dt.GetTags().front()->FollowingSiblings().empty());
+	EXPECT_EQ(3, std::ranges::count_if(dt.Descendants(), [](const Tag* tag) { return TagId::li == tag->m_id; }));
+	EXPECT_EQ(dt.GetElementById("s1"), *std::ranges::find_if(dt.Descendants(), [](const Tag* tag) { return TagId::span == tag->m_id; }));
+
+	// a child added by hand is walked too
+	Tag* li = dt.GetElementById("u1")->AddChild(Tag{ "li", std::vector<Attribute>{ { "id", "l4" } } });
+	li->AddText("4");
+	EXPECT_EQ("li#l1 li#l2 li#l3 li#l4", elements(dt.GetElementById("u1")->Descendants()));
+	static_assert(std::ranges::forward_range<CTagRange<CTagIterator<TagOrder::pre>>>);
+	static_assert(std::ranges::view<CTagRange<CAncestorIterator>>);
+}
+
+TEST(TestIterators, deep)
+{
+	constexpr size_t depth{ 100000 };
+	std::string html{};
+	for (size_t i = 0; i < depth; ++i)
+		html += "<div>";
+	html += "x";
+	for (size_t i = 0; i < depth; ++i)
+		html += "</div>";
+	CDomTree dt{};
+	dt.Parse(html);
+	EXPECT_EQ(depth + 1, std::ranges::distance(dt.Descendants()));
+	EXPECT_EQ(depth + 1, std::ranges::distance(dt.DescendantsPostOrder()));
+	EXPECT_EQ(html, dt.GetData(DataFormat::compact));
+	EXPECT_EQ(depth, std::ranges::distance((*std::ranges::next(dt.Descendants().begin(), depth))->Ancestors()));
+}
+
+TEST(TestTreeCorrection, impliedEndTags)
+{
+	const auto corrected = [](std::string html)
+		{
+			CDomTree dt{};
+			dt.Parse(std::move(html));
+			return dt.GetData(DataFormat::compact);
+		};
+	EXPECT_EQ("<ul><li>a</li><li>b</li><li>c<ul><li>d</li></ul></li></ul>", corrected("<ul><li>a<li>b<li>c<ul><li>d</ul></ul>"));
+	EXPECT_EQ("<dl><dt>t</dt><dd>d</dd><dt>t2</dt><dd>d2</dd></dl>", corrected("<dl><dt>t<dd>d<dt>t2<dd>d2</dl>"));
+	EXPECT_EQ("<select><option>1</option><optgroup><option>2</option><option>3</option></optgroup></select>",
+		corrected("<select><option>1<optgroup><option>2<option>3</select>"));
+	EXPECT_EQ("<table><thead><tr><td>h</td></tr></thead><tbody><tr><td>1</td><td>2</td></tr><tr><td>3</td></tr></tbody></table>",
+		corrected("<table><thead><tr><td>h<tbody><tr><td>1<td>2<tr><td>3</table>"));
+	EXPECT_EQ("<table><tr><td><table><tr><td>x</td></tr></table></td><td>y</td></tr></table>",
+		corrected("<table><tr><td><table><tr><td>x</table><td>y</table>"));
+	EXPECT_EQ("<body><p>a</p><p>b</p><div>c</div></body>", corrected("<body><p>a<p>b<div>c</div></p></body>"));
+	EXPECT_EQ("<a>x</a><a>y</a>", corrected("<a>x<a>y</a>"));
+
+	// a closing tag closes the open tags above its own, a closing tag without an open tag is ignored
+	EXPECT_EQ("<div><span>a</span></div><p>b</p>", corrected("<div><span>a</div><p>b"));
+	EXPECT_EQ("<div>x</div>", corrected("<div></span>x</div>"));
+	EXPECT_EQ("<table><tr><td><div>x</div></td></tr></table>", corrected("<table><tr><td><div>x</td></div></table>"));
+	EXPECT_EQ("<x-a><x-b><x-a>q</x-a>r</x-b></x-a>", corrected("<x-a><x-b><X-A>q</x-a>r</x-b></x-a>"));
+
+	// a button bounds the paragraph its blocks close
+	EXPECT_EQ("<body><p>a<button><div>b</div></button>c</p><div>d</div></body>",
+		corrected("<body><p>a<button><div>b</div></button>c<div>d</div></body>"));
+}
+
+TEST(TestEntities, decode)
+{
+	std::string buffer{};
+	const std::string_view plain{ "no reference here" };
+	EXPECT_EQ(plain.data(), DecodeEntities(plain, buffer).data());
+	EXPECT_EQ("a & b &ampx; &amp &#; &unknown;", DecodeEntities("a & b &ampx; &amp &#; &unknown;"));
+	EXPECT_EQ("<>\"'&", DecodeEntities("&lt;&gt;&quot;&apos;&amp;"));
+	EXPECT_EQ("\xC2\xA0\xC3\xA9\xC3\xA9\xC3\xA9\xF0\x9F\x98\x80\xE2\x80\x93\xEF\xBF\xBD", DecodeEntities("&nbsp;&eacute;&#233;&#xE9&#x1F600;&#150;&#0;"));
+	EXPECT_EQ("\xCE\xA9 \xE2\x82\xAC", DecodeEntities("&Omega; &euro;"));
+
+	CDomTree dt{ ParseOptions{ .m_zeroCopy = true, .m_decodeEntities = true } };
+	const std::string html{ "<body><p title=\"a &amp; &quot;b&quot;\">x &lt; y &amp;&amp; caf&eacute;</p><script>if (a &lt; b && c) {}</script><p>plain</p></body>" };
+	dt.ParseView(html);
+	ASSERT_EQ(1, dt.GetTags().size());
+	const auto& body = dt.GetTags()[0]->m_childs;
+	ASSERT_EQ(3, body.size());
+	EXPECT_EQ("a & \"b\"", body[0]->GetAttribute(AttributeId::title));
+	EXPECT_EQ("x < y && caf\xC3\xA9", body[0]->m_childs[0]->m_value);
+	EXPECT_EQ("if (a &lt; b && c) {}", body[1]->m_childs[0]->m_value);
+	EXPECT_TRUE(body[2]->m_childs[0]->m_value.IsView());	// nothing decoded, nothing copied
+	EXPECT_EQ("<body><p title=\"a &amp; &quot;b&quot;\">x &lt; y &amp;&amp; caf\xC3\xA9</p><script>if (a &lt; b && c) {}</script><p>plain</p></body>",
+		dt.GetData(DataFormat::compact));
+
+	// without the option the references are kept as written
+	CDomTree raw{};
+	raw.Parse(html);
+	EXPECT_EQ(html, raw.GetData(DataFormat::compact));
+}
+
+TEST(TestCharset, detectAndTranscode)
+{
+	EXPECT_EQ(Charset::utf8, DetectCharset("\xEF\xBB\xBF<html>"));
+	EXPECT_EQ(Charset::windows_1250, DetectCharset("<html><head><META CHARSET='Windows-1250'>"));
+	EXPECT_EQ(Charset::iso_8859_2, DetectCharset("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=ISO-8859-2\">"));
+	EXPECT_EQ(Charset::windows_1252, DetectCharset("<meta charset=\"latin1\"/>"));
+	EXPECT_EQ(Charset::unknown, DetectCharset("<html><head><title>charset=utf-8</title>"));
+
+	EXPECT_TRUE(IsValidUtf8("a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"));
+	EXPECT_FALSE(IsValidUtf8("\xC0\xAF"));				// overlong
+	EXPECT_FALSE(IsValidUtf8("\xED\xA0\x80"));			// surrogate
+	EXPECT_FALSE(IsValidUtf8("\xF4\x90\x80\x80"));		// above U+10FFFF
+	EXPECT_FALSE(IsValidUtf8("\xE2\x82"));				// truncated
+	EXPECT_EQ(40, FindInvalidUtf8(std::string(40, 'a') + "\xFF" + std::string(40, 'b')));
+
+	// "ştiinţă Ą" in windows-1250 and in ISO-8859-2, they differ on Ą
+	// the text of html > body > p
+	const auto paragraph = [](const CDomTree& dt) { return dt.GetTags().back()->m_childs.back()->m_childs.front()->m_childs.front(); };
+	const auto text = [&paragraph](const CDomTree& dt) { return std::string(paragraph(dt)->m_value.view()); };
+	CDomTree dt{};
+	dt.Parse(std::string{ "<html><head><meta charset=\"windows-1250\"></head><body><p>\xBAtiin\xFE\xE3 \xA5</p></body></html>" });
+	EXPECT_EQ(Charset::windows_1250, dt.GetDocumentCharset());
+	EXPECT_EQ("\xC5\x9Ftiin\xC5\xA3\xC4\x83 \xC4\x84", text(dt));
+	dt.Clear();
+	dt.Parse(std::string{ "<html><head><meta charset=\"iso-8859-2\"></head><body><p>\xBAtiin\xFE\xE3 \xA1</p></body></html>" });
+	EXPECT_EQ(Charset::iso_8859_2, dt.GetDocumentCharset());
+	EXPECT_EQ("\xC5\x9Ftiin\xC5\xA3\xC4\x83 \xC4\x84", text(dt));
+
+	// an undeclared document which isn't UTF-8 is read as windows-1252, invalid UTF-8 is replaced
+	dt.Clear();
+	dt.Parse(std::string{ "<html><body><p>caf\xE9</p></body></html>" });
+	EXPECT_EQ(Charset::windows_1252, dt.GetDocumentCharset());
+	EXPECT_EQ("caf\xC3\xA9", text(dt));
+	dt.Clear();
+	dt.Parse(std::string{ "\xEF\xBB\xBF<html><body><p>a\xFF" "b</p></body></html>" });
+	EXPECT_EQ(Charset::utf8, dt.GetDocumentCharset());
+	EXPECT_EQ(1, dt.GetTags().size());
+	EXPECT_EQ("a\xEF\xBF\xBD" "b", text(dt));
+
+	// a UTF-8 document is parsed in place
+	const std::string utf8{ "<html><body><p>\xC8\x99tiin\xC8\x9B\xC4\x83</p></body></html>" };
+	CDomTree view{ ParseOptions{ .m_zeroCopy = true } };
+	view.ParseView(utf8);
+	EXPECT_EQ(Charset::utf8, view.GetDocumentCharset());
+	EXPECT_EQ(utf8.data() + utf8.find("\xC8"), paragraph(view)->m_value.view().data());
+
+	// fed chunks of a forced charset
+	CDomTree stream{ ParseOptions{ .m_charset = Charset::iso_8859_2 } };
+	const std::string chunks{ "<html><body><p>\xBAtiin\xFE\xE3 \xA1</p></body></html>" };
+	for (const char c : chunks)
+		stream.Feed(std::string_view(&c, 1));
+	stream.Finish();
+	EXPECT_EQ("\xC5\x9Ftiin\xC5\xA3\xC4\x83 \xC4\x84", text(stream));
+}
+
+TEST(TestAttributes, lazy)
+{
+	const std::string html{ "<html><body><div id=\"d1\" CLASS=\"a b\" data-X='1' hidden>"
+		"<a href=\"/x?a=1&amp;b=2\" title=\"t\">link</a><img src=\"1.png\"/></div></body></html>" };
+	CDomTree eager{};
+	eager.Parse(html);
+	CDomTree lazy{ ParseOptions{ .m_lazyAttributes = true } };
+	lazy.Parse(html);
+	Tag* a = lazy.GetTags().at(0)->m_childs.at(0)->m_childs.at(0)->m_childs.at(0);
+	ASSERT_EQ("a", a->m_name);
+	Tag* div = a->m_parent;
+	Tag* img = div->m_childs.at(1);
+	EXPECT_TRUE(a->m_attributes.IsPending());
+	EXPECT_TRUE(img->m_attributes.IsPending());
+	EXPECT_EQ("/x?a=1&amp;b=2", a->GetAttribute(AttributeId::href));
+	EXPECT_FALSE(a->m_attributes.IsPending());
+	EXPECT_EQ("t", a->GetAttribute("title"));
+	EXPECT_EQ(eager.GetData(), lazy.GetData());
+	EXPECT_EQ(eager.GetData(DataFormat::compact), lazy.GetData(DataFormat::compact));
+
+	// the loaded tags can be changed, copied and moved
+	EXPECT_EQ(div, lazy.GetElementById("d1"));
+	const Tag copy{ *img };
+	Tag moved{ std::move(*img) };
+	EXPECT_EQ("1.png", copy.GetAttribute("src"));
+	EXPECT_EQ("1.png", moved.GetAttribute("src"));
+	EXPECT_TRUE(img->m_attributes.empty());
+	div->SetAttribute("role", "main");
+	EXPECT_EQ(5, div->m_attributes.size());
+	EXPECT_TRUE(div->HasAttribute("hidden"));
+	EXPECT_EQ("1", div->GetAttribute("data-x"));
+
+	// a pending tag is copied and moved before its attributes are parsed
+	CDomTree pending{ ParseOptions{ .m_lazyAttributes = true } };
+	pending.Parse(html);
+	Tag* source = pending.GetTags().at(0)->m_childs.at(0)->m_childs.at(0);
+	Tag pending_copy{ *source };
+	Tag pending_moved{ std::move(*source) };
+	EXPECT_EQ("d1", pending_copy.GetAttribute("id"));
+	EXPECT_EQ("a b", pending_moved.GetAttribute(AttributeId::class_));
+	EXPECT_EQ(4, pending_moved.m_attributes.size());
+	EXPECT_TRUE(source->m_attributes.empty());
+
+	// with zero copy the values view the document, with decoding they are decoded at the first access
+	CDomTree view{ ParseOptions{ .m_zeroCopy = true, .m_decodeEntities = true, .m_lazyAttributes = true } };
+	view.ParseView(html);
+	const Tag* link = view.GetTags().at(0)->m_childs.at(0)->m_childs.at(0)->m_childs.at(0);
+	EXPECT_EQ("/x?a=1&b=2", link->GetAttribute("href"));
+	EXPECT_EQ(html.data() + html.find("\"t\"") + 1, link->GetAttribute("title").data());
+}
+
+TEST(TestAttributes, lazyConcurrentReaders)
+{
+	std::string html{ "<div>" };
+	for (int i = 0; i < 2000; ++i)
+		html += "<p id=\"p" + std::to_string(i) + "\" class=\"a b\" data-i='" + std::to_string(i) + "' title=\"t\" hidden></p>";
+	html += "</div>";
+	CDomTree lazy{ ParseOptions{ .m_lazyAttributes = true } };
+	lazy.Parse(html);
+	const CDomTree& tree{ lazy };
+	// every thread reads every tag, the first access to a tag parses its attributes
+	std::vector<int> failures(8);
+	std::vector<std::thread> readers{};
+	for (size_t t = 0; t < failures.size(); ++t)
+	{
+		readers.emplace_back([&tree, &failures, t]()
+			{
+				int i{};
+				for (const Tag* tag : tree.GetTags().at(0)->Childs())
+				{
+					if (5 != tag->m_attributes.size() || "p" + std::to_string(i) != tag->GetAttribute(AttributeId::id) ||
+						std::to_string(i) != tag->GetAttribute("data-i") || !tag->HasAttribute("hidden"))
+						failures[t]++;
+					i++;
+				}
+			});
+	}
+	for (auto& reader : readers)
+		reader.join();
+	for (const int failed : failures)
+		EXPECT_EQ(0, failed);
+}
+
+TEST(TestContentFilter, scriptStyleSvgComments)
+{
+	const std::string html{ "<html><head><style>p { color: red }</style><script>if (a<b) x(\"</p>\");</script></head>"
+		"<body><!-- note --><p>text</p><svg viewBox=\"0 0 8 8\"><path d=\"M0\"/></svg><p>more</p></body></html>" };
+	const auto parse = [&html](const ContentFilter filter)
+		{
+			CDomTree dt{ ParseOptions{ .m_scriptContent = filter, .m_styleContent = filter, .m_svgContent = filter, .m_comments = filter } };
+			dt.Parse(html);
+			return dt.GetData(DataFormat::compact);
+		};
+	EXPECT_EQ(html, parse(ContentFilter::keep));
+	EXPECT_EQ("<html><head><style></style><script></script></head><body><!----><p>text</p>"
+		"<svg viewBox=\"0 0 8 8\"></svg><p>more</p></body></html>", parse(ContentFilter::empty));
+	EXPECT_EQ("<html><head></head><body><p>text</p><p>more</p></body></html>", parse(ContentFilter::skip));
+
+	// only the scripts are skipped, a fed document gives the same tags
+	const ParseOptions options{ .m_scriptContent = ContentFilter::skip };
+	CDomTree dt{ options };
+	dt.Parse(html);
+	EXPECT_EQ("<html><head><style>p { color: red }</style></head><body><!-- note --><p>text</p>"
+		"<svg viewBox=\"0 0 8 8\"><path d=\"M0\"/></svg><p>more</p></body></html>", dt.GetData(DataFormat::compact));
+	CDomTree stream{ options };
+	for (const char c : html)
+		stream.Feed(std::string_view(&c, 1));
+	stream.Finish();
+	EXPECT_EQ(dt.GetData(), stream.GetData());
+	EXPECT_TRUE(stream.GetElementsByTagName("script").empty());
+}
+
+TEST(TestCharset, feed)
+{
+	// the fed chunks give the same tags as the parsed document, whatever the chunk boundaries
+	const auto feed = [](const std::string& html, const size_t size)
+		{
+			CDomTree dt{};
+			for (size_t pos = 0; pos < html.size(); pos += size)
+				dt.Feed(std::string_view(html).substr(pos, size));
+			dt.Finish();
+			return dt;
+		};
+	const auto check = [&feed](const std::string& html, const Charset charset)
+		{
+			CDomTree parsed{};
+			parsed.Parse(html);
+			EXPECT_EQ(charset, parsed.GetDocumentCharset());
+			for (const size_t size : { 1, 2, 3, 5, 7, 1000, 4096 })
+			{
+				const CDomTree fed{ feed(html, size) };
+				EXPECT_EQ(charset, fed.GetDocumentCharset());
+				EXPECT_EQ(parsed.GetData(), fed.GetData()) << "chunks of " << size;
+			}
+		};
+
+	// windows-1250 declared after the first chunks, "ştiinţă Ą"
+	check("<html><head><title>t</title><meta charset=\"windows-1250\"></head><body><p>\xBAtiin\xFE\xE3 \xA5</p></body></html>",
+		Charset::windows_1250);
+	// UTF-8 after the sniffed characters, with sequences split by the chunks and an invalid byte far from the start
+	check("\xEF\xBB\xBF<html><body><p>" + std::string(1100, 'a') + "\xC8\x99tiin\xC8\x9B\xC4\x83 \xF0\x9F\x98\x80 \xFF \xE2\x82</p></body></html>",
+		Charset::utf8);
+	// undeclared, not UTF-8 in the first characters
+	check("<html><body><p>caf\xE9</p></body></html>", Charset::windows_1252);
+
+	const CDomTree fed{ feed("\xEF\xBB\xBF<html><body><p>\xC8\x99</p><p>a\xFF" "b</p></body></html>", 1) };
+	EXPECT_EQ("\xC8\x99", fed.GetTags().back()->m_childs.back()->m_childs.front()->m_childs.front()->m_value);
+	EXPECT_EQ("a\xEF\xBF\xBD" "b", fed.GetTags().back()->m_childs.back()->m_childs.back()->m_childs.front()->m_value);
+}
+
 int main()
 {
 	testing::InitGoogleTest();
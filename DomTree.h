@@ -12,15 +12,64 @@
 
 #pragma once
 
+#include <new>
+#include <bit>
+#include <span>
 #include <array>
-#include <stack>
+#include <atomic>
 #include <string>
+#include <ranges>
 #include <vector>
+#include <deque>
+#include <mutex>
 #include <memory>
-#include <sstream>
+#include <utility>
+#include <thread>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
 #include <iterator>
+#include <stdexcept>
 #include <algorithm>
+#include <filesystem>
 #include <string_view>
+#include <type_traits>
+#include <initializer_list>
+#include <unordered_map>
+
+#if !defined(DOMTREE_NO_SIMD)
+#if defined(__AVX2__)
+#define DOMTREE_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DOMTREE_SSE2
+#endif
+#endif
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#if !defined(WIN32_LEAN_AND_MEAN)
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(DOMTREE_AVX2)
+#include <immintrin.h>
+#elif defined(DOMTREE_SSE2)
+#include <emmintrin.h>
+#endif
 
 namespace domtree
 {
@@ -51,834 +100,6231 @@ namespace domtree
 		"align"
 	};
 
-	struct Attribute
+	// known tag names, a tag name is mapped once to its id when the tag is parsed
+	enum class TagId : uint8_t
 	{
-		std::string m_key{};
-		std::string m_value{};
-		char m_quote{ '\"' };
+		unknown = 0, a, abbr, address, align, area, article, aside, audio, b, base, bdi, bdo,
+		blockquote, body, br, button, canvas, caption, center, cite, code, col, colgroup, command,
+		data, datalist, dd, del, details, dfn, dialog, div, dl, dt, em, embed, fieldset,
+		figcaption, figure, font, footer, form, frame, frameset, h1, h2, h3, h4, h5, h6, head,
+		header, hgroup, hr, html, i, iframe, img, input, ins, kbd, keygen, label, legend, li, link,
+		main, map, mark, menu, meta, meter, nav, nobr, noscript, object, ol, optgroup, option,
+		output, p, param, picture, pre, progress, q, rp, rt, ruby, s, samp, script, section,
+		select, slot, small, source, span, strong, style, sub, summary, sup, svg, table, tbody, td,
+		template_, textarea, tfoot, th, thead, time, title, tr, track, u, ul, var, video, wbr,
+		count
 	};
 
-	struct Tag
+	constexpr size_t tag_count{ static_cast<size_t>(TagId::count) };
+
+	// indexed by TagId
+	constexpr std::array<std::string_view, tag_count> tag_names
 	{
-	public:
-		Tag() = default;
-		Tag(const std::string& name)
-			: m_name(name)
+		"", "a", "abbr", "address", "align", "area", "article", "aside", "audio", "b", "base",
+		"bdi", "bdo", "blockquote", "body", "br", "button", "canvas", "caption", "center", "cite",
+		"code", "col", "colgroup", "command", "data", "datalist", "dd", "del", "details", "dfn",
+		"dialog", "div", "dl", "dt", "em", "embed", "fieldset", "figcaption", "figure", "font",
+		"footer", "form", "frame", "frameset", "h1", "h2", "h3", "h4", "h5", "h6", "head",
+		"header", "hgroup", "hr", "html", "i", "iframe", "img", "input", "ins", "kbd", "keygen",
+		"label", "legend", "li", "link", "main", "map", "mark", "menu", "meta", "meter", "nav",
+		"nobr", "noscript", "object", "ol", "optgroup", "option", "output", "p", "param",
+		"picture", "pre", "progress", "q", "rp", "rt", "ruby", "s", "samp", "script", "section",
+		"select", "slot", "small", "source", "span", "strong", "style", "sub", "summary", "sup",
+		"svg", "table", "tbody", "td", "template", "textarea", "tfoot", "th", "thead", "time",
+		"title", "tr", "track", "u", "ul", "var", "video", "wbr"
+	};
+
+	constexpr char ToLower(const char c)
+	{
+		return ('A' <= c && 'Z' >= c) ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	// true if text is lower once lowercased
+	constexpr bool EqualsLower(std::string_view text, std::string_view lower)
+	{
+		if (text.size() != lower.size())
+			return false;
+		for (size_t i = 0; i < text.size(); ++i)
 		{
+			if (ToLower(text[i]) != lower[i])
+				return false;
 		}
-		Tag(const std::string& name, const std::string& value)
-			: m_name(name)
-			, m_value(value)
+		return true;
+	}
+
+	// true if both texts are the same once lowercased
+	constexpr bool EqualsNoCase(std::string_view lhs, std::string_view rhs)
+	{
+		if (lhs.size() != rhs.size())
+			return false;
+		for (size_t i = 0; i < lhs.size(); ++i)
 		{
+			if (ToLower(lhs[i]) != ToLower(rhs[i]))
+				return false;
 		}
-		Tag(const std::string& name, const std::string& value, const std::vector<Attribute>& attributes)
-			: m_name(name)
-			, m_value(value)
-			, m_attributes(attributes)
+		return true;
+	}
+
+	// FNV-1a over the lowercase name, the seed makes it a perfect hash for tag_names
+	constexpr size_t tag_hash_size{ 1024 };
+	constexpr uint32_t tag_hash_seed{ 1070 };
+	constexpr size_t TagNameHash(std::string_view name)
+	{
+		uint32_t hash{ tag_hash_seed };
+		for (const char c : name)
+			hash = (hash ^ static_cast<uint8_t>(ToLower(c))) * 16777619u;
+		hash ^= hash >> 15;
+		return hash & (tag_hash_size - 1);
+	}
+
+	constexpr std::array<TagId, tag_hash_size> tag_hash_table = []
+	{
+		std::array<TagId, tag_hash_size> table{};
+		for (size_t id = 1; id < tag_count; ++id)
+			table[TagNameHash(tag_names[id])] = static_cast<TagId>(id);
+		return table;
+	}();
+
+	// case insensitive, return TagId::unknown if the name is not a known tag
+	constexpr TagId GetTagId(std::string_view name)
+	{
+		const TagId id = tag_hash_table[TagNameHash(name)];
+		const std::string_view known = tag_names[static_cast<size_t>(id)];
+		if (known.size() != name.size())
+			return TagId::unknown;
+		for (size_t i = 0; i < name.size(); ++i)
 		{
+			if (known[i] != ToLower(name[i]))
+				return TagId::unknown;
 		}
-		Tag(const std::string& name, const std::vector<Attribute>& attributes)
-			: m_name(name)
-			, m_attributes(attributes)
+		return id;
+	}
+
+	static_assert([]
+		{
+			for (size_t id = 1; id < tag_count; ++id)
+			{
+				if (GetTagId(tag_names[id]) != static_cast<TagId>(id))
+					return false;
+			}
+			return true;
+		}(), "tag_hash_seed doesn't give a perfect hash for tag_names");
+
+	// properties of the known tags, indexed by TagId
+	struct TagTraits
+	{
+		bool m_selfClosing{ false };
+		bool m_nonValid{ false };
+		bool m_multiLine{ false };	// script, style and svg, the content is kept as one text
+	};
+
+	constexpr std::array<TagTraits, tag_count> tag_traits = []
+	{
+		std::array<TagTraits, tag_count> traits{};
+		for (const auto& name : self_closing_tags)
+			traits[static_cast<size_t>(GetTagId(name))].m_selfClosing = true;
+		for (const auto& name : non_valid_tags)
+			traits[static_cast<size_t>(GetTagId(name))].m_nonValid = true;
+		for (const TagId id : { TagId::script, TagId::style, TagId::svg })
+			traits[static_cast<size_t>(id)].m_multiLine = true;
+		return traits;
+	}();
+
+	constexpr const TagTraits& GetTagTraits(const TagId id)
+	{
+		return tag_traits[static_cast<size_t>(id)];
+	}
+
+	// the tags named by the tree correction rules, a rule mask has one bit per tag of this list
+	constexpr std::array<TagId, 24> rule_tags
+	{
+		TagId::a, TagId::button, TagId::caption, TagId::datalist, TagId::dd, TagId::dl, TagId::dt,
+		TagId::html, TagId::li, TagId::menu, TagId::ol, TagId::optgroup, TagId::option, TagId::p,
+		TagId::select, TagId::table, TagId::tbody, TagId::td, TagId::template_, TagId::tfoot, TagId::th,
+		TagId::thead, TagId::tr, TagId::ul
+	};
+
+	static_assert(rule_tags.size() <= 32, "a rule mask has 32 bits");
+
+	constexpr uint32_t RuleMask(std::initializer_list<TagId> ids)
+	{
+		uint32_t mask{};
+		for (const TagId id : ids)
 		{
+			for (size_t bit = 0; bit < rule_tags.size(); ++bit)
+			{
+				if (rule_tags[bit] == id)
+					mask |= 1u << bit;
+			}
 		}
-		Tag(std::string&& name)
-			: m_name(std::move(name))
+		return mask;
+	}
+
+	// tree correction of the tags, the open tags are kept on a stack: an opening tag closes the deepest
+	// open tag of m_closes found before a tag of m_openScope, a closing tag closes the nearest open tag
+	// with its id found before a tag of m_closeScope, it is ignored otherwise
+	struct TagRules
+	{
+		uint32_t m_mask{};			// the bit of the tag, 0 if no rule names it
+		uint32_t m_closes{};		// implied end tags
+		uint32_t m_openScope{};
+		uint32_t m_closeScope{};
+	};
+
+	constexpr std::array<TagRules, tag_count> tag_rules = []
+	{
+		constexpr uint32_t scope{ RuleMask({ TagId::caption, TagId::html, TagId::table, TagId::td, TagId::template_, TagId::th }) };
+		constexpr uint32_t button_scope{ scope | RuleMask({ TagId::button }) };
+		constexpr uint32_t table_scope{ RuleMask({ TagId::html, TagId::table, TagId::template_ }) };
+		constexpr uint32_t p{ RuleMask({ TagId::p }) };
+
+		std::array<TagRules, tag_count> rules{};
+		for (size_t id = 0; id < tag_count; ++id)
 		{
+			rules[id].m_mask = RuleMask({ static_cast<TagId>(id) });
+			rules[id].m_openScope = scope;
+			rules[id].m_closeScope = scope;
 		}
-		Tag(std::string&& name, std::string&& value)
-			: m_name(std::move(name))
-			, m_value(std::move(value))
+		const auto set = [&rules](std::initializer_list<TagId> ids, const uint32_t closes, const uint32_t openScope, const uint32_t closeScope)
+		{
+			for (const TagId id : ids)
+				rules[static_cast<size_t>(id)] = { rules[static_cast<size_t>(id)].m_mask, closes, openScope, closeScope };
+		};
+		// the blocks close an open paragraph
+		set({ TagId::address, TagId::article, TagId::aside, TagId::blockquote, TagId::center, TagId::details,
+			TagId::dialog, TagId::div, TagId::dl, TagId::fieldset, TagId::figcaption, TagId::figure, TagId::footer,
+			TagId::form, TagId::h1, TagId::h2, TagId::h3, TagId::h4, TagId::h5, TagId::h6, TagId::header,
+			TagId::hgroup, TagId::hr, TagId::main, TagId::menu, TagId::nav, TagId::ol, TagId::p, TagId::pre,
+			TagId::section, TagId::summary, TagId::table, TagId::ul }, p, button_scope, scope);
+		set({ TagId::p }, p, button_scope, button_scope);
+		set({ TagId::table }, p, button_scope, table_scope);
+		set({ TagId::a }, RuleMask({ TagId::a }), scope, scope);
+		set({ TagId::li }, RuleMask({ TagId::li, TagId::p }), scope | RuleMask({ TagId::menu, TagId::ol, TagId::ul }),
+			scope | RuleMask({ TagId::menu, TagId::ol, TagId::ul }));
+		set({ TagId::dd, TagId::dt }, RuleMask({ TagId::dd, TagId::dt, TagId::p }), scope | RuleMask({ TagId::dl }), scope);
+		set({ TagId::option }, RuleMask({ TagId::option }), scope | RuleMask({ TagId::datalist, TagId::optgroup, TagId::select }),
+			scope | RuleMask({ TagId::select }));
+		set({ TagId::optgroup }, RuleMask({ TagId::optgroup, TagId::option }), scope | RuleMask({ TagId::datalist, TagId::select }),
+			scope | RuleMask({ TagId::select }));
+		set({ TagId::td, TagId::th }, RuleMask({ TagId::td, TagId::th }), table_scope | RuleMask({ TagId::tr }), table_scope);
+		set({ TagId::tr }, RuleMask({ TagId::td, TagId::th, TagId::tr }),
+			table_scope | RuleMask({ TagId::tbody, TagId::tfoot, TagId::thead }), table_scope);
+		set({ TagId::tbody, TagId::tfoot, TagId::thead }, RuleMask({ TagId::tbody, TagId::td, TagId::tfoot, TagId::th, TagId::thead, TagId::tr }),
+			table_scope, table_scope);
+		return rules;
+	}();
+
+	constexpr const TagRules& GetTagRules(const TagId id)
+	{
+		return tag_rules[static_cast<size_t>(id)];
+	}
+
+	// known attribute names, a key is mapped once to its id when the attribute is parsed
+	enum class AttributeId : uint8_t
+	{
+		unknown = 0, accept, accesskey, action, align, alt, async, autocomplete, autoplay, bgcolor,
+		border, cellpadding, cellspacing, charset, checked, class_, cols, colspan, content, controls,
+		crossorigin, data, datetime, decoding, defer, dir, disabled, download, enctype, for_, form,
+		frameborder, headers, height, hidden, href, hreflang, http_equiv, id, integrity, itemprop,
+		itemscope, itemtype, label, lang, loading, max, maxlength, media, method, min, multiple, name,
+		nonce, onclick, onload, pattern, placeholder, poster, property, readonly, referrerpolicy, rel,
+		required, role, rows, rowspan, sandbox, scope, selected, size, sizes, span, src, srcset, start,
+		step, style, tabindex, target, title, type, usemap, valign, value, width, wrap, xmlns,
+		count
+	};
+
+	constexpr size_t attribute_count{ static_cast<size_t>(AttributeId::count) };
+
+	// indexed by AttributeId, the parsed keys which are known are views of these names
+	constexpr std::array<std::string_view, attribute_count> attribute_names
+	{
+		"", "accept", "accesskey", "action", "align", "alt", "async", "autocomplete", "autoplay",
+		"bgcolor", "border", "cellpadding", "cellspacing", "charset", "checked", "class", "cols",
+		"colspan", "content", "controls", "crossorigin", "data", "datetime", "decoding", "defer",
+		"dir", "disabled", "download", "enctype", "for", "form", "frameborder", "headers", "height",
+		"hidden", "href", "hreflang", "http-equiv", "id", "integrity", "itemprop", "itemscope",
+		"itemtype", "label", "lang", "loading", "max", "maxlength", "media", "method", "min",
+		"multiple", "name", "nonce", "onclick", "onload", "pattern", "placeholder", "poster",
+		"property", "readonly", "referrerpolicy", "rel", "required", "role", "rows", "rowspan",
+		"sandbox", "scope", "selected", "size", "sizes", "span", "src", "srcset", "start", "step",
+		"style", "tabindex", "target", "title", "type", "usemap", "valign", "value", "width", "wrap",
+		"xmlns"
+	};
+
+	// same hash as TagNameHash, with its own seed for attribute_names
+	constexpr size_t attribute_hash_size{ 512 };
+	constexpr uint32_t attribute_hash_seed{ 293 };
+	constexpr size_t AttributeNameHash(std::string_view name)
+	{
+		uint32_t hash{ attribute_hash_seed };
+		for (const char c : name)
+			hash = (hash ^ static_cast<uint8_t>(ToLower(c))) * 16777619u;
+		hash ^= hash >> 15;
+		return hash & (attribute_hash_size - 1);
+	}
+
+	constexpr std::array<AttributeId, attribute_hash_size> attribute_hash_table = []
+	{
+		std::array<AttributeId, attribute_hash_size> table{};
+		for (size_t id = 1; id < attribute_count; ++id)
+			table[AttributeNameHash(attribute_names[id])] = static_cast<AttributeId>(id);
+		return table;
+	}();
+
+	// case insensitive, return AttributeId::unknown if the key is not a known attribute
+	constexpr AttributeId GetAttributeId(std::string_view key)
+	{
+		const AttributeId id = attribute_hash_table[AttributeNameHash(key)];
+		return EqualsLower(key, attribute_names[static_cast<size_t>(id)]) ? id : AttributeId::unknown;
+	}
+
+	static_assert([]
+		{
+			for (size_t id = 1; id < attribute_count; ++id)
+			{
+				if (GetAttributeId(attribute_names[id]) != static_cast<AttributeId>(id))
+					return false;
+			}
+			return true;
+		}(), "attribute_hash_seed doesn't give a perfect hash for attribute_names");
+
+	// delimiter scanners, they test 32 (AVX2) or 16 (SSE2) characters at once and the tail one by one
+#if defined(DOMTREE_SSE2)
+	template <char... Chars>
+	inline __m128i MatchAny(const __m128i block)
+	{
+		__m128i match = _mm_setzero_si128();
+		((match = _mm_or_si128(match, _mm_cmpeq_epi8(block, _mm_set1_epi8(Chars)))), ...);
+		return match;
+	}
+#endif
+#if defined(DOMTREE_AVX2)
+	template <char... Chars>
+	inline __m256i MatchAny(const __m256i block)
+	{
+		__m256i match = _mm256_setzero_si256();
+		((match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(Chars)))), ...);
+		return match;
+	}
+#endif
+
+	// return the position of the first character from pos which is one of Chars, data.size() if there is none;
+	// pos is returned as is if it is past the end
+	template <char... Chars>
+	inline size_t FindFirstOf(std::string_view data, size_t pos)
+	{
+		const size_t size = data.size();
+		if (pos >= size)
+			return pos;
+
+		const char* text = data.data();
+#if defined(DOMTREE_AVX2)
+		for (; pos + 32 <= size; pos += 32)
 		{
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+			const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(MatchAny<Chars...>(block)));
+			if (mask)
+				return pos + std::countr_zero(mask);
 		}
-		Tag(std::string&& name, std::string&& value, std::vector<Attribute>&& attributes)
-			: m_name(std::move(name))
-			, m_value(std::move(value))
-			, m_attributes(std::move(attributes))
+#endif
+#if defined(DOMTREE_SSE2)
+		for (; pos + 16 <= size; pos += 16)
 		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+			const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(MatchAny<Chars...>(block)));
+			if (mask)
+				return pos + std::countr_zero(mask);
 		}
-		Tag(std::string&& name, std::vector<Attribute>&& attributes)
-			: m_name(std::move(name))
-			, m_attributes(std::move(attributes))
+#endif
+		for (; pos < size; ++pos)
 		{
+			if (((Chars == text[pos]) || ...))
+				return pos;
 		}
-		Tag(const Tag& rhs)
-			: m_parent(rhs.m_parent)
-			, m_name(rhs.m_name)
-			, m_value(rhs.m_value)
-			, m_childs(rhs.m_childs)
-			, m_attributes(rhs.m_attributes)
+		return size;
+	}
+
+	// return the position of the first character from pos which is none of Chars, data.size() if there is none;
+	// pos is returned as is if it is past the end
+	template <char... Chars>
+	inline size_t FindFirstNotOf(std::string_view data, size_t pos)
+	{
+		const size_t size = data.size();
+		if (pos >= size)
+			return pos;
+
+		const char* text = data.data();
+		if (!((Chars == text[pos]) || ...))	// most runs are empty
+			return pos;
+#if defined(DOMTREE_AVX2)
+		for (; pos + 32 <= size; pos += 32)
 		{
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(MatchAny<Chars...>(block)));
+			if (mask)
+				return pos + std::countr_zero(mask);
 		}
-		Tag& operator=(const Tag& rhs)
+#endif
+#if defined(DOMTREE_SSE2)
+		for (; pos + 16 <= size; pos += 16)
 		{
-			if (this != &rhs)
-			{
-				m_parent = rhs.m_parent;
-				m_name = rhs.m_name;
-				m_value = rhs.m_value;
-				m_childs = rhs.m_childs;
-				m_attributes = rhs.m_attributes;
-			}
-			return *this;
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(MatchAny<Chars...>(block))) & 0xFFFF;
+			if (mask)
+				return pos + std::countr_zero(mask);
 		}
-		Tag(Tag&& rhs) noexcept
-			: m_parent(std::move(rhs.m_parent))
-			, m_name(std::move(rhs.m_name))
-			, m_value(std::move(rhs.m_value))
-			, m_childs(std::move(rhs.m_childs))
-			, m_attributes(std::move(rhs.m_attributes))
+#endif
+		for (; pos < size; ++pos)
 		{
-			rhs.m_parent = nullptr;
+			if (!((Chars == text[pos]) || ...))
+				return pos;
 		}
-		Tag& operator=(Tag&& rhs) noexcept
+		return size;
+	}
+
+	// walk the attributes of a tag from index up to the closing '>' and return the position reached,
+	// onAttribute(key, value, quote) is called for every attribute
+	template <typename Callback>
+	size_t ScanAttributes(std::string_view data, size_t index, Callback&& onAttribute)
+	{
+		char quote{ '\"' };
+		while (index < data.length() && '>' != data[index])
 		{
-			if (this != &rhs)
+			index = FindFirstNotOf<' ', '\n', '\r', '\t'>(data, index);
+
+			if (index < data.length() && '>' != data[index] && '/' != data[index])
 			{
-				m_parent = std::move(rhs.m_parent);
-				m_name = std::move(rhs.m_name);
-				m_value = std::move(rhs.m_value);
-				m_childs = std::move(rhs.m_childs);
-				m_attributes = std::move(rhs.m_attributes);
+				const size_t keyStart{ index };
+				index = FindFirstOf<'=', '>', ' ', '\n', '\r', '\t'>(data, index);
+				const std::string_view key{ data.substr(keyStart, index - keyStart) };
+				std::string_view value{};
 
-				rhs.m_parent = nullptr;
+				index = FindFirstNotOf<' ', '\n', '\r', '\t'>(data, index);
+				if (index < data.length() && '=' == data[index])
+				{
+					index++;
+					index = FindFirstNotOf<' ', '\n', '\r', '\t'>(data, index);
+					if (index < data.length() && ('\"' == data[index] || '\'' == data[index]))
+					{
+						quote = data[index++];
+						const size_t valueStart{ index };
+						index = ('\"' == quote ? FindFirstOf<'\"'>(data, index) : FindFirstOf<'\''>(data, index));
+						value = data.substr(valueStart, index - valueStart);
+					}
+				}
+				else
+				{
+					index--;
+				}
+				onAttribute(key, value, quote);
 			}
-			return *this;
+
+			if (index >= data.length() || '>' != data[index])
+				index++;
 		}
-		~Tag() = default;
+		return index;
+	}
 
-	public:
-		std::string m_name{};
-		std::string m_value{};
-		std::vector<Attribute> m_attributes{};
-		std::vector<std::shared_ptr<Tag>> m_childs{};
-		Tag* m_parent{};
+	// return the position of "</" + name from index, or the length of data - 5 if there is none;
+	// name has 3 lowercase characters
+	inline size_t FindClosingTag(std::string_view data, size_t index, const std::string_view name)
+	{
+		const std::string_view head{ data.substr(0, data.length() > 5 ? data.length() - 5 : 0) };
+		while ((index = FindFirstOf<'<'>(head, index)) < head.length()
+			&& !('/' == data[index + 1]
+				&& name[0] == ToLower(data[index + 2])
+				&& name[1] == ToLower(data[index + 3])
+				&& name[2] == ToLower(data[index + 4])))
+			index++;
+		return index;
+	}
 
-	public:
-		void AddAttributes(const std::vector<Attribute>& attributes)
+	// charsets of the parsed documents, a document is parsed as UTF-8 so the others are transcoded
+	enum class Charset : uint8_t
+	{
+		unknown = 0, utf8, windows_1250, iso_8859_2, windows_1252
+	};
+
+	// the characters 0x80 - 0xff of the single byte charsets, in the order of Charset from windows_1250;
+	// iso-8859-1 is read as windows-1252 like browsers do
+	constexpr std::array<std::array<char16_t, 128>, 3> legacy_charsets
+	{ {
+		{ {	// windows-1250
+			0x20AC, 0x0081, 0x201A, 0x0083, 0x201E, 0x2026, 0x2020, 0x2021, 0x0088, 0x2030, 0x0160, 0x2039, 0x015A, 0x0164, 0x017D, 0x0179,
+			0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0098, 0x2122, 0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A,
+			0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B,
+			0x00B0, 0x00B1, 0x02DB, 0x0142, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C,
+			0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+			0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7, 0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+			0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7, 0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+			0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7, 0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9
+		} },
+		{ {	// iso-8859-2
+			0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087, 0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x008D, 0x008E, 0x008F,
+			0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009A, 0x009B, 0x009C, 0x009D, 0x009E, 0x009F,
+			0x00A0, 0x0104, 0x02D8, 0x0141, 0x00A4, 0x013D, 0x015A, 0x00A7, 0x00A8, 0x0160, 0x015E, 0x0164, 0x0179, 0x00AD, 0x017D, 0x017B,
+			0x00B0, 0x0105, 0x02DB, 0x0142, 0x00B4, 0x013E, 0x015B, 0x02C7, 0x00B8, 0x0161, 0x015F, 0x0165, 0x017A, 0x02DD, 0x017E, 0x017C,
+			0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+			0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7, 0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+			0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7, 0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+			0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7, 0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9
+		} },
+		{ {	// windows-1252
+			0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+			0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+			0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+			0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+			0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+			0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+			0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7, 0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+			0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF
+		} }
+	} };
+
+	constexpr const std::array<char16_t, 128>& GetLegacyCharset(const Charset charset)
+	{
+		return legacy_charsets[static_cast<size_t>(charset) - static_cast<size_t>(Charset::windows_1250)];
+	}
+
+	// case insensitive charset label of a <meta>, return Charset::unknown if the label isn't supported
+	constexpr Charset GetCharset(std::string_view label)
+	{
+		struct Label
+		{
+			std::string_view m_label{};
+			Charset m_charset{};
+		};
+		constexpr Label labels[]
 		{
-			std::copy(std::begin(attributes), std::end(attributes), std::back_inserter(m_attributes));
+			{ "utf-8", Charset::utf8 }, { "utf8", Charset::utf8 }, { "unicode-1-1-utf-8", Charset::utf8 },
+			{ "windows-1250", Charset::windows_1250 }, { "cp1250", Charset::windows_1250 }, { "x-cp1250", Charset::windows_1250 },
+			{ "iso-8859-2", Charset::iso_8859_2 }, { "iso8859-2", Charset::iso_8859_2 }, { "iso_8859-2", Charset::iso_8859_2 },
+			{ "latin2", Charset::iso_8859_2 }, { "l2", Charset::iso_8859_2 }, { "csisolatin2", Charset::iso_8859_2 },
+			{ "windows-1252", Charset::windows_1252 }, { "cp1252", Charset::windows_1252 }, { "x-cp1252", Charset::windows_1252 },
+			{ "iso-8859-1", Charset::windows_1252 }, { "iso8859-1", Charset::windows_1252 }, { "iso_8859-1", Charset::windows_1252 },
+			{ "latin1", Charset::windows_1252 }, { "l1", Charset::windows_1252 }, { "us-ascii", Charset::windows_1252 },
+			{ "ascii", Charset::windows_1252 }
+		};
+		for (const auto& it : labels)
+		{
+			if (EqualsLower(label, it.m_label))
+				return it.m_charset;
 		}
-		void AddAttributes(std::vector<Attribute>&& attributes)
+		return Charset::unknown;
+	}
+
+	constexpr std::string_view utf8_bom{ "\xEF\xBB\xBF" };
+	constexpr size_t charset_sniff_size{ 1024 };
+
+	// the charset given by a BOM or by a <meta> in the first 1024 characters (charset="..." or
+	// content="text/html; charset=..."), Charset::unknown if there is none
+	inline Charset DetectCharset(std::string_view data)
+	{
+		if (data.starts_with(utf8_bom))
+			return Charset::utf8;
+
+		const std::string_view head{ data.substr(0, charset_sniff_size) };
+		for (size_t index = FindFirstOf<'<'>(head, 0); index + 5 < head.size(); index = FindFirstOf<'<'>(head, index + 1))
 		{
-			if (m_attributes.empty())
-			{
-				m_attributes = std::move(attributes);
-			}
-			else
+			if (!EqualsLower(head.substr(index + 1, 4), "meta"))
+				continue;
+			const std::string_view tag{ head.substr(index, FindFirstOf<'>'>(head, index) - index) };
+			for (size_t pos = 5; pos + 7 < tag.size(); ++pos)
 			{
-				m_attributes.reserve(m_attributes.size() + attributes.size());
-				std::move(std::begin(attributes), std::end(attributes), std::back_inserter(m_attributes));
-				attributes.clear();
+				if (!EqualsLower(tag.substr(pos, 7), "charset"))
+					continue;
+				pos = FindFirstNotOf<' ', '\n', '\r', '\t'>(tag, pos + 7);
+				if (pos >= tag.size() || '=' != tag[pos])
+					continue;
+				pos = FindFirstNotOf<' ', '\n', '\r', '\t', '\"', '\''>(tag, pos + 1);
+				const size_t end{ FindFirstOf<' ', '\n', '\r', '\t', '\"', '\'', ';', '/'>(tag, pos) };
+				return GetCharset(tag.substr(pos, end - pos));
 			}
 		}
-		void SetValue(const std::string& text)
+		return Charset::unknown;
+	}
+
+	// return the position of the first character from pos which isn't ASCII, data.size() if there is none
+	inline size_t FindFirstNonAscii(std::string_view data, size_t pos)
+	{
+		const size_t size = data.size();
+		if (pos >= size)
+			return pos;
+
+		const char* text = data.data();
+#if defined(DOMTREE_AVX2)
+		for (; pos + 32 <= size; pos += 32)
 		{
-			m_value = text;
+			const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos))));
+			if (mask)
+				return pos + std::countr_zero(mask);
 		}
-		void SetValue(std::string&& text)
+#endif
+#if defined(DOMTREE_SSE2)
+		for (; pos + 16 <= size; pos += 16)
 		{
-			m_value = std::move(text);
+			const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos))));
+			if (mask)
+				return pos + std::countr_zero(mask);
+		}
+#endif
+		for (; pos < size; ++pos)
+		{
+			if (static_cast<uint8_t>(text[pos]) >= 0x80)
+				return pos;
 		}
-		void AddText(const std::string& text)
+		return size;
+	}
+
+	// the length of the UTF-8 sequence at pos, 0 if it isn't valid (overlong, surrogate, above U+10FFFF or truncated)
+	constexpr size_t GetUtf8Length(std::string_view data, const size_t pos)
+	{
+		const auto byte = [&data](const size_t index) { return index < data.size() ? static_cast<uint8_t>(data[index]) : uint8_t{}; };
+		const auto between = [](const uint8_t c, const uint8_t low, const uint8_t high) { return c >= low && c <= high; };
+		const uint8_t lead{ byte(pos) };
+		if (lead < 0x80)
+			return 1;
+		if (between(lead, 0xC2, 0xDF))
+			return between(byte(pos + 1), 0x80, 0xBF) ? 2 : 0;
+
+		uint8_t low{ 0x80 };
+		uint8_t high{ 0xBF };
+		size_t length{};
+		if (between(lead, 0xE0, 0xEF))
 		{
-			Tag tag{};
-			tag.m_value = text;
-			tag.m_parent = this;
-			m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
+			length = 3;
+			if (0xE0 == lead)
+				low = 0xA0;
+			else if (0xED == lead)
+				high = 0x9F;
 		}
-		void AddText(std::string&& text)
+		else if (between(lead, 0xF0, 0xF4))
 		{
-			Tag tag{};
-			tag.m_value = std::move(text);
-			tag.m_parent = this;
-			m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
+			length = 4;
+			if (0xF0 == lead)
+				low = 0x90;
+			else if (0xF4 == lead)
+				high = 0x8F;
 		}
-		void AddChild(Tag& tag)
+		else
 		{
-			tag.m_parent = this;
-			m_childs.push_back(std::make_shared<Tag>(tag));
+			return 0;
 		}
-		void AddChild(Tag&& tag)
+		if (!between(byte(pos + 1), low, high))
+			return 0;
+		for (size_t index = 2; index < length; ++index)
 		{
-			tag.m_parent = this;
-			m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
+			if (!between(byte(pos + index), 0x80, 0xBF))
+				return 0;
 		}
-	};
+		return length;
+	}
 
-	class CDomTree
+	// return the position of the first invalid UTF-8 sequence, data.size() if there is none;
+	// the ASCII runs are skipped 32 (AVX2) or 16 (SSE2) characters at once
+	inline size_t FindInvalidUtf8(std::string_view data, size_t pos = 0)
 	{
-	public:
-		CDomTree() = default;
-		CDomTree(const CDomTree& rhs) = delete;
-		CDomTree& operator=(const CDomTree& rhs) = delete;
-		CDomTree(CDomTree&& rhs) noexcept
-			: m_currentTag(std::move(rhs.m_currentTag))
-			, m_data(std::move(rhs.m_data))
-			, m_tags(std::move(rhs.m_tags))
-			, m_tables(std::move(rhs.m_tables))
-			, m_bufferIndex(std::move(rhs.m_bufferIndex))
-			, m_svg(std::move(rhs.m_svg))
-			, m_style(std::move(rhs.m_style))
-			, m_script(std::move(rhs.m_script))
-			, m_td(std::move(rhs.m_td))
-			, m_tr(std::move(rhs.m_tr))
-			, m_table(std::move(rhs.m_table))
-			, m_p(std::move(rhs.m_p))
-			, m_a(std::move(rhs.m_a))
-			, m_label(std::move(rhs.m_label))
+		while ((pos = FindFirstNonAscii(data, pos)) < data.size())
 		{
-			rhs.m_currentTag = nullptr;
-			rhs.m_bufferIndex = 0;
-			rhs.m_svg = false;
-			rhs.m_style = false;
-			rhs.m_script = false;
-			rhs.m_td = TagState::closed;
-			rhs.m_tr = TagState::closed;
-			rhs.m_table = TagState::closed;
-			rhs.m_p = TagState::closed;
-			rhs.m_a = TagState::closed;
-			rhs.m_label = TagState::closed;
+			const size_t length{ GetUtf8Length(data, pos) };
+			if (!length)
+				return pos;
+			pos += length;
 		}
-		CDomTree& operator=(CDomTree&& rhs) noexcept
+		return data.size();
+	}
+
+	inline bool IsValidUtf8(std::string_view data)
+	{
+		return data.size() == FindInvalidUtf8(data);
+	}
+
+	// the number of characters at the end of data which start a UTF-8 sequence cut by the end of data
+	constexpr size_t GetTruncatedUtf8Length(std::string_view data)
+	{
+		for (size_t back = 1; back <= 3 && back <= data.size(); ++back)
 		{
-			if (this != &rhs)
+			const uint8_t c{ static_cast<uint8_t>(data[data.size() - back]) };
+			if (c < 0x80)
+				return 0;
+			if (c >= 0xC0)
 			{
-				m_currentTag = std::move(rhs.m_currentTag);
-				m_data = std::move(rhs.m_data);
-				m_tags = std::move(rhs.m_tags);
-				m_tables = std::move(rhs.m_tables);
-				m_bufferIndex = std::move(rhs.m_bufferIndex);
-				m_svg = std::move(rhs.m_svg);
-				m_style = std::move(rhs.m_style);
-				m_script = std::move(rhs.m_script);
-				m_td = std::move(rhs.m_td);
-				m_tr = std::move(rhs.m_tr);
-				m_table = std::move(rhs.m_table);
-				m_p = std::move(rhs.m_p);
-				m_a = std::move(rhs.m_a);
-				m_label = std::move(rhs.m_label);
-
-				rhs.m_currentTag = nullptr;
-				rhs.m_bufferIndex = 0;
-				rhs.m_svg = false;
-				rhs.m_style = false;
-				rhs.m_script = false;
-				rhs.m_td = TagState::closed;
-				rhs.m_tr = TagState::closed;
-				rhs.m_table = TagState::closed;
-				rhs.m_p = TagState::closed;
-				rhs.m_a = TagState::closed;
-				rhs.m_label = TagState::closed;
+				const size_t length{ c >= 0xF0 ? 4u : c >= 0xE0 ? 3u : 2u };
+				return length > back ? back : 0;
 			}
-			return *this;
 		}
-		~CDomTree() = default;
+		return 0;
+	}
 
-	public:
-		std::vector<std::shared_ptr<Tag>>& GetTags() { return m_tags; }
-		const std::vector<std::shared_ptr<Tag>>& GetTags() const { return m_tags; }
-		void Parse(const std::string& data)
+	// append data read in charset to out as UTF-8 in one pass, the ASCII runs are copied as they are;
+	// for Charset::utf8 the invalid sequences are replaced with U+FFFD
+	inline void TranscodeToUtf8(std::string_view data, const Charset charset, std::string& out)
+	{
+		constexpr std::string_view replacement{ "\xEF\xBF\xBD" };
+		size_t pos{};
+		while (pos < data.size())
 		{
-			m_data = data;
-			Parse();
+			const size_t next{ FindFirstNonAscii(data, pos) };
+			out.append(data.substr(pos, next - pos));
+			if (next >= data.size())
+				break;
+			pos = next;
+			if (Charset::utf8 == charset || Charset::unknown == charset)
+			{
+				const size_t length{ GetUtf8Length(data, pos) };
+				if (length)
+					out.append(data.substr(pos, length));
+				else
+					out.append(replacement);
+				pos += std::max<size_t>(length, 1);
+				continue;
+			}
+			const char16_t c{ GetLegacyCharset(charset)[static_cast<uint8_t>(data[pos]) - 0x80] };
+			if (c < 0x800)
+			{
+				out += static_cast<char>(0xC0 | (c >> 6));
+				out += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				out += static_cast<char>(0xE0 | (c >> 12));
+				out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			pos++;
 		}
+	}
 
-		void Parse(std::string&& data)
-		{
-			m_data = std::move(data);
-			Parse();
-		}
+	// named character references, the HTML 4 set and &apos;
+	struct Entity
+	{
+		std::string_view m_name{};
+		char32_t m_codepoint{};
+	};
 
-		std::string GetData() const
-		{
-			std::string out{};
-			PrintData(m_tags, out);
-			return out + "\n";
-		}
+	constexpr std::array<Entity, 253> entities
+	{ {
+		{ "AElig", 0xC6 }, { "Aacute", 0xC1 }, { "Acirc", 0xC2 }, { "Agrave", 0xC0 }, { "Alpha", 0x391 },
+		{ "Aring", 0xC5 }, { "Atilde", 0xC3 }, { "Auml", 0xC4 }, { "Beta", 0x392 }, { "Ccedil", 0xC7 }, { "Chi", 0x3A7 },
+		{ "Dagger", 0x2021 }, { "Delta", 0x394 }, { "ETH", 0xD0 }, { "Eacute", 0xC9 }, { "Ecirc", 0xCA },
+		{ "Egrave", 0xC8 }, { "Epsilon", 0x395 }, { "Eta", 0x397 }, { "Euml", 0xCB }, { "Gamma", 0x393 },
+		{ "Iacute", 0xCD }, { "Icirc", 0xCE }, { "Igrave", 0xCC }, { "Iota", 0x399 }, { "Iuml", 0xCF }, { "Kappa", 0x39A },
+		{ "Lambda", 0x39B }, { "Mu", 0x39C }, { "Ntilde", 0xD1 }, { "Nu", 0x39D }, { "OElig", 0x152 }, { "Oacute", 0xD3 },
+		{ "Ocirc", 0xD4 }, { "Ograve", 0xD2 }, { "Omega", 0x3A9 }, { "Omicron", 0x39F }, { "Oslash", 0xD8 },
+		{ "Otilde", 0xD5 }, { "Ouml", 0xD6 }, { "Phi", 0x3A6 }, { "Pi", 0x3A0 }, { "Prime", 0x2033 }, { "Psi", 0x3A8 },
+		{ "Rho", 0x3A1 }, { "Scaron", 0x160 }, { "Sigma", 0x3A3 }, { "THORN", 0xDE }, { "Tau", 0x3A4 }, { "Theta", 0x398 },
+		{ "Uacute", 0xDA }, { "Ucirc", 0xDB }, { "Ugrave", 0xD9 }, { "Upsilon", 0x3A5 }, { "Uuml", 0xDC }, { "Xi", 0x39E },
+		{ "Yacute", 0xDD }, { "Yuml", 0x178 }, { "Zeta", 0x396 }, { "aacute", 0xE1 }, { "acirc", 0xE2 }, { "acute", 0xB4 },
+		{ "aelig", 0xE6 }, { "agrave", 0xE0 }, { "alefsym", 0x2135 }, { "alpha", 0x3B1 }, { "amp", 0x26 },
+		{ "and", 0x2227 }, { "ang", 0x2220 }, { "apos", 0x27 }, { "aring", 0xE5 }, { "asymp", 0x2248 }, { "atilde", 0xE3 },
+		{ "auml", 0xE4 }, { "bdquo", 0x201E }, { "beta", 0x3B2 }, { "brvbar", 0xA6 }, { "bull", 0x2022 },
+		{ "cap", 0x2229 }, { "ccedil", 0xE7 }, { "cedil", 0xB8 }, { "cent", 0xA2 }, { "chi", 0x3C7 }, { "circ", 0x2C6 },
+		{ "clubs", 0x2663 }, { "cong", 0x2245 }, { "copy", 0xA9 }, { "crarr", 0x21B5 }, { "cup", 0x222A },
+		{ "curren", 0xA4 }, { "dArr", 0x21D3 }, { "dagger", 0x2020 }, { "darr", 0x2193 }, { "deg", 0xB0 },
+		{ "delta", 0x3B4 }, { "diams", 0x2666 }, { "divide", 0xF7 }, { "eacute", 0xE9 }, { "ecirc", 0xEA },
+		{ "egrave", 0xE8 }, { "empty", 0x2205 }, { "emsp", 0x2003 }, { "ensp", 0x2002 }, { "epsilon", 0x3B5 },
+		{ "equiv", 0x2261 }, { "eta", 0x3B7 }, { "eth", 0xF0 }, { "euml", 0xEB }, { "euro", 0x20AC }, { "exist", 0x2203 },
+		{ "fnof", 0x192 }, { "forall", 0x2200 }, { "frac12", 0xBD }, { "frac14", 0xBC }, { "frac34", 0xBE },
+		{ "frasl", 0x2044 }, { "gamma", 0x3B3 }, { "ge", 0x2265 }, { "gt", 0x3E }, { "hArr", 0x21D4 }, { "harr", 0x2194 },
+		{ "hearts", 0x2665 }, { "hellip", 0x2026 }, { "iacute", 0xED }, { "icirc", 0xEE }, { "iexcl", 0xA1 },
+		{ "igrave", 0xEC }, { "image", 0x2111 }, { "infin", 0x221E }, { "int", 0x222B }, { "iota", 0x3B9 },
+		{ "iquest", 0xBF }, { "isin", 0x2208 }, { "iuml", 0xEF }, { "kappa", 0x3BA }, { "lArr", 0x21D0 },
+		{ "lambda", 0x3BB }, { "lang", 0x2329 }, { "laquo", 0xAB }, { "larr", 0x2190 }, { "lceil", 0x2308 },
+		{ "ldquo", 0x201C }, { "le", 0x2264 }, { "lfloor", 0x230A }, { "lowast", 0x2217 }, { "loz", 0x25CA },
+		{ "lrm", 0x200E }, { "lsaquo", 0x2039 }, { "lsquo", 0x2018 }, { "lt", 0x3C }, { "macr", 0xAF },
+		{ "mdash", 0x2014 }, { "micro", 0xB5 }, { "middot", 0xB7 }, { "minus", 0x2212 }, { "mu", 0x3BC },
+		{ "nabla", 0x2207 }, { "nbsp", 0xA0 }, { "ndash", 0x2013 }, { "ne", 0x2260 }, { "ni", 0x220B }, { "not", 0xAC },
+		{ "notin", 0x2209 }, { "nsub", 0x2284 }, { "ntilde", 0xF1 }, { "nu", 0x3BD }, { "oacute", 0xF3 },
+		{ "ocirc", 0xF4 }, { "oelig", 0x153 }, { "ograve", 0xF2 }, { "oline", 0x203E }, { "omega", 0x3C9 },
+		{ "omicron", 0x3BF }, { "oplus", 0x2295 }, { "or", 0x2228 }, { "ordf", 0xAA }, { "ordm", 0xBA },
+		{ "oslash", 0xF8 }, { "otilde", 0xF5 }, { "otimes", 0x2297 }, { "ouml", 0xF6 }, { "para", 0xB6 },
+		{ "part", 0x2202 }, { "permil", 0x2030 }, { "perp", 0x22A5 }, { "phi", 0x3C6 }, { "pi", 0x3C0 }, { "piv", 0x3D6 },
+		{ "plusmn", 0xB1 }, { "pound", 0xA3 }, { "prime", 0x2032 }, { "prod", 0x220F }, { "prop", 0x221D },
+		{ "psi", 0x3C8 }, { "quot", 0x22 }, { "rArr", 0x21D2 }, { "radic", 0x221A }, { "rang", 0x232A }, { "raquo", 0xBB },
+		{ "rarr", 0x2192 }, { "rceil", 0x2309 }, { "rdquo", 0x201D }, { "real", 0x211C }, { "reg", 0xAE },
+		{ "rfloor", 0x230B }, { "rho", 0x3C1 }, { "rlm", 0x200F }, { "rsaquo", 0x203A }, { "rsquo", 0x2019 },
+		{ "sbquo", 0x201A }, { "scaron", 0x161 }, { "sdot", 0x22C5 }, { "sect", 0xA7 }, { "shy", 0xAD },
+		{ "sigma", 0x3C3 }, { "sigmaf", 0x3C2 }, { "sim", 0x223C }, { "spades", 0x2660 }, { "sub", 0x2282 },
+		{ "sube", 0x2286 }, { "sum", 0x2211 }, { "sup", 0x2283 }, { "sup1", 0xB9 }, { "sup2", 0xB2 }, { "sup3", 0xB3 },
+		{ "supe", 0x2287 }, { "szlig", 0xDF }, { "tau", 0x3C4 }, { "there4", 0x2234 }, { "theta", 0x3B8 },
+		{ "thetasym", 0x3D1 }, { "thinsp", 0x2009 }, { "thorn", 0xFE }, { "tilde", 0x2DC }, { "times", 0xD7 },
+		{ "trade", 0x2122 }, { "uArr", 0x21D1 }, { "uacute", 0xFA }, { "uarr", 0x2191 }, { "ucirc", 0xFB },
+		{ "ugrave", 0xF9 }, { "uml", 0xA8 }, { "upsih", 0x3D2 }, { "upsilon", 0x3C5 }, { "uuml", 0xFC },
+		{ "weierp", 0x2118 }, { "xi", 0x3BE }, { "yacute", 0xFD }, { "yen", 0xA5 }, { "yuml", 0xFF }, { "zeta", 0x3B6 },
+		{ "zwj", 0x200D }, { "zwnj", 0x200C }
+	} };
 
-	private:
-		void Parse()
+	// trie of the entity names, the childs of a node are linked by m_sibling and node 0 is the root
+	struct EntityNode
+	{
+		char m_char{};
+		uint16_t m_child{};		// first child, 0 if none
+		uint16_t m_sibling{};	// next child of the same parent, 0 if none
+		char32_t m_codepoint{};	// of the name which ends at this node, 0 if none
+	};
+
+	constexpr size_t entity_trie_size = []
+	{
+		size_t size{ 1 };
+		for (const auto& entity : entities)
+			size += entity.m_name.size();
+		return size;
+	}();
+
+	constexpr std::array<EntityNode, entity_trie_size> entity_trie = []
+	{
+		std::array<EntityNode, entity_trie_size> trie{};
+		uint16_t used{ 1 };
+		for (const auto& entity : entities)
 		{
-			m_bufferIndex = 0;
-			while (m_bufferIndex < m_data.length())
+			uint16_t node{};
+			for (const char c : entity.m_name)
+			{
+				uint16_t child{ trie[node].m_child };
+				while (child && c != trie[child].m_char)
+					child = trie[child].m_sibling;
+				if (!child)
+				{
+					child = used++;
+					trie[child].m_char = c;
+					trie[child].m_sibling = trie[node].m_child;
+					trie[node].m_child = child;
+				}
+				node = child;
+			}
+			trie[node].m_codepoint = entity.m_codepoint;
+		}
+		return trie;
+	}();
+
+	// the reference which starts with the '&' at pos, return the position after it and set codepoint,
+	// or return pos if it isn't a reference; a named reference needs its ';', a numeric one doesn't,
+	// 0x80 - 0x9f are read as windows-1252 like browsers do
+	constexpr size_t ParseEntity(std::string_view text, size_t pos, char32_t& codepoint)
+	{
+		size_t index{ pos + 1 };
+		if (index < text.size() && '#' == text[index])
+		{
+			index++;
+			const bool hex{ index < text.size() && ('x' == text[index] || 'X' == text[index]) };
+			if (hex)
+				index++;
+			const size_t digits{ index };
+			uint32_t value{};
+			for (; index < text.size(); ++index)
+			{
+				const char c{ ToLower(text[index]) };
+				uint32_t digit{};
+				if ('0' <= c && '9' >= c)
+					digit = c - '0';
+				else if (hex && 'a' <= c && 'f' >= c)
+					digit = c - 'a' + 10;
+				else
+					break;
+				value = std::min<uint32_t>(value * (hex ? 16 : 10) + digit, 0x110000);
+			}
+			if (digits == index)
+				return pos;
+			if (index < text.size() && ';' == text[index])
+				index++;
+
+			if (0 == value || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+				codepoint = 0xFFFD;
+			else if (value >= 0x80 && value <= 0x9F)
+				codepoint = GetLegacyCharset(Charset::windows_1252)[value - 0x80];
+			else
+				codepoint = value;
+			return index;
+		}
+
+		uint16_t node{};
+		for (; index < text.size(); ++index)
+		{
+			if (';' == text[index])
+			{
+				if (!node || !entity_trie[node].m_codepoint)
+					return pos;
+				codepoint = entity_trie[node].m_codepoint;
+				return index + 1;
+			}
+			uint16_t child{ entity_trie[node].m_child };
+			while (child && text[index] != entity_trie[child].m_char)
+				child = entity_trie[child].m_sibling;
+			if (!child)
+				return pos;
+			node = child;
+		}
+		return pos;
+	}
+
+	static_assert([]
+		{
+			for (const auto& entity : entities)
+			{
+				char32_t codepoint{};
+				const std::string reference{ "&" + std::string(entity.m_name) + ";" };
+				if (reference.size() != ParseEntity(reference, 0, codepoint) || entity.m_codepoint != codepoint)
+					return false;
+			}
+			return true;
+		}(), "entity_trie doesn't find every name of entities");
+
+	inline void AppendUtf8(std::string& out, const char32_t codepoint)
+	{
+		if (codepoint < 0x80)
+		{
+			out += static_cast<char>(codepoint);
+		}
+		else if (codepoint < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (codepoint >> 6));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (codepoint >> 12));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (codepoint >> 18));
+			out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	// decode the character references of text as UTF-8, return text itself if there is nothing to decode
+	// (most texts have no '&', they cost one scan), otherwise the decoded text kept in buffer
+	inline std::string_view DecodeEntities(std::string_view text, std::string& buffer)
+	{
+		size_t pos{ FindFirstOf<'&'>(text, 0) };
+		size_t copied{};	// characters of text already in buffer
+		for (; pos < text.size(); pos = FindFirstOf<'&'>(text, pos))
+		{
+			char32_t codepoint{};
+			const size_t end{ ParseEntity(text, pos, codepoint) };
+			if (end == pos)
+			{
+				pos++;
+				continue;
+			}
+			if (!copied)
+				buffer.clear();
+			buffer.append(text.substr(copied, pos - copied));
+			AppendUtf8(buffer, codepoint);
+			copied = pos = end;
+		}
+		if (!copied)
+			return text;
+		buffer.append(text.substr(copied));
+		return buffer;
+	}
+
+	inline std::string DecodeEntities(std::string_view text)
+	{
+		std::string buffer{};
+		return std::string(DecodeEntities(text, buffer));
+	}
+
+	// string that either owns its characters or is a view into the parsed buffer
+	class CDomString
+	{
+	public:
+		static constexpr size_t npos{ std::string_view::npos };
+
+	public:
+		CDomString() = default;
+		CDomString(const char* text)
+			: CDomString(std::string_view(text))
+		{
+		}
+		CDomString(const std::string& text)
+			: CDomString(std::string_view(text))
+		{
+		}
+		CDomString(std::string_view text)
+		{
+			Assign(text);
+		}
+		CDomString(const CDomString& rhs)
+		{
+			if (rhs.m_owned)
+				Assign(rhs.view());
+			else
+				m_data = rhs.m_data, m_size = rhs.m_size;
+		}
+		CDomString& operator=(const CDomString& rhs)
+		{
+			if (this != &rhs)
+			{
+				if (rhs.m_owned)
+				{
+					Assign(rhs.view());
+				}
+				else
+				{
+					Release();
+					m_data = rhs.m_data;
+					m_size = rhs.m_size;
+				}
+			}
+			return *this;
+		}
+		CDomString(CDomString&& rhs) noexcept
+			: m_data(rhs.m_data)
+			, m_size(rhs.m_size)
+			, m_owned(rhs.m_owned)
+		{
+			rhs.m_data = "";
+			rhs.m_size = 0;
+			rhs.m_owned = false;
+		}
+		CDomString& operator=(CDomString&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				Release();
+				m_data = rhs.m_data;
+				m_size = rhs.m_size;
+				m_owned = rhs.m_owned;
+
+				rhs.m_data = "";
+				rhs.m_size = 0;
+				rhs.m_owned = false;
+			}
+			return *this;
+		}
+		CDomString& operator=(std::string_view text)
+		{
+			Assign(text);
+			return *this;
+		}
+		CDomString& operator=(const std::string& text) { return *this = std::string_view(text); }
+		CDomString& operator=(const char* text) { return *this = std::string_view(text); }
+		~CDomString() { Release(); }
+
+		// non owning string, the caller keeps the characters alive
+		static CDomString View(std::string_view text)
+		{
+			CDomString out{};
+			out.m_data = text.data();
+			out.m_size = text.size();
+			return out;
+		}
+
+	public:
+		std::string_view view() const { return { m_data, m_size }; }
+		operator std::string_view() const { return view(); }
+		explicit operator std::string() const { return std::string(view()); }
+		std::string str() const { return std::string(view()); }
+
+		const char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+		size_t length() const { return m_size; }
+		bool empty() const { return 0 == m_size; }
+		char front() const { return m_data[0]; }
+		char back() const { return m_data[m_size - 1]; }
+		char operator[](const size_t index) const { return m_data[index]; }
+		const char* begin() const { return m_data; }
+		const char* end() const { return m_data + m_size; }
+
+		std::string_view substr(const size_t pos = 0, const size_t count = npos) const { return view().substr(pos, count); }
+		size_t find(const char c, const size_t pos = 0) const { return view().find(c, pos); }
+		size_t find(std::string_view text, const size_t pos = 0) const { return view().find(text, pos); }
+		size_t find_first_not_of(std::string_view chars, const size_t pos = 0) const { return view().find_first_not_of(chars, pos); }
+		size_t find_last_not_of(std::string_view chars, const size_t pos = npos) const { return view().find_last_not_of(chars, pos); }
+
+		CDomString& operator+=(const char c)
+		{
+			return *this += std::string_view(&c, 1);
+		}
+		CDomString& operator+=(std::string_view text)
+		{
+			char* data = new char[m_size + text.size() + 1];
+			std::copy(m_data, m_data + m_size, data);
+			std::copy(text.begin(), text.end(), data + m_size);
+			data[m_size + text.size()] = '\0';
+			const size_t size = m_size + text.size();
+			Release();
+			m_data = data;
+			m_size = size;
+			m_owned = true;
+			return *this;
+		}
+
+		// true if the string is a view into a buffer it doesn't own
+		bool IsView() const { return !m_owned && 0 != m_size; }
+		// take a private copy of the viewed characters
+		void MakeOwned()
+		{
+			if (IsView())
+				Assign(view());
+		}
+
+		friend bool operator==(const CDomString& lhs, std::string_view rhs) { return lhs.view() == rhs; }
+		friend auto operator<=>(const CDomString& lhs, std::string_view rhs) { return lhs.view() <=> rhs; }
+		friend bool operator==(const CDomString& lhs, const char* rhs) { return lhs.view() == std::string_view(rhs); }
+		friend auto operator<=>(const CDomString& lhs, const char* rhs) { return lhs.view() <=> std::string_view(rhs); }
+		friend bool operator==(const CDomString& lhs, const CDomString& rhs) { return lhs.view() == rhs.view(); }
+		friend auto operator<=>(const CDomString& lhs, const CDomString& rhs) { return lhs.view() <=> rhs.view(); }
+		friend std::ostream& operator<<(std::ostream& os, const CDomString& text) { return os << text.view(); }
+
+	private:
+		void Assign(std::string_view text)
+		{
+			if (text.empty())
+			{
+				Release();
+				return;
+			}
+			char* data = new char[text.size() + 1];
+			std::copy(text.begin(), text.end(), data);
+			data[text.size()] = '\0';
+			Release();
+			m_data = data;
+			m_size = text.size();
+			m_owned = true;
+		}
+		void Release()
+		{
+			if (m_owned)
+				delete[] m_data;
+			m_data = "";
+			m_size = 0;
+			m_owned = false;
+		}
+
+	private:
+		const char* m_data{ "" };
+		size_t m_size{};
+		bool m_owned{ false };
+	};
+
+	struct Attribute
+	{
+	public:
+		Attribute() = default;
+		Attribute(CDomString key, CDomString value, const char quote = '\"')
+			: m_key(std::move(key))
+			, m_value(std::move(value))
+			, m_quote(quote)
+			, m_id(GetAttributeId(m_key))
+		{
+		}
+		Attribute(CDomString key, CDomString value, const char quote, const AttributeId id)
+			: m_key(std::move(key))
+			, m_value(std::move(value))
+			, m_quote(quote)
+			, m_id(id)
+		{
+		}
+
+	public:
+		CDomString m_key{};
+		CDomString m_value{};
+		char m_quote{ '\"' };
+		AttributeId m_id{ AttributeId::unknown };	// id of m_key
+	};
+
+	// how the attributes parsed from a document keep their strings
+	struct AttributeSource
+	{
+		bool m_views{ false };		// views into the document instead of copies
+		bool m_decode{ false };		// the character references are decoded, a decoded value is a copy
+	};
+
+	// attributes of a tag, the first inline_count of them are stored in the list itself
+	// so most tags need no allocation for their attributes; a pending list keeps only the attribute
+	// section of its tag (in the inline storage) and parses it at the first access, even a const one,
+	// so concurrent readers of pending lists need their own synchronization
+	class CAttributeList
+	{
+	public:
+		using value_type = Attribute;
+		using iterator = Attribute*;
+		using const_iterator = const Attribute*;
+		static constexpr size_t inline_count{ 4 };
+
+	public:
+		CAttributeList() = default;
+		CAttributeList(std::initializer_list<Attribute> attributes)
+		{
+			reserve(attributes.size());
+			for (const auto& attr : attributes)
+				push_back(attr);
+		}
+		CAttributeList(const std::vector<Attribute>& attributes)
+		{
+			reserve(attributes.size());
+			for (const auto& attr : attributes)
+				push_back(attr);
+		}
+		CAttributeList(std::vector<Attribute>&& attributes)
+		{
+			reserve(attributes.size());
+			for (auto& attr : attributes)
+				push_back(std::move(attr));
+			attributes.clear();
+		}
+		CAttributeList(const CAttributeList& rhs)
+		{
+			reserve(rhs.size());
+			for (const auto& attr : rhs)
+				push_back(attr);
+		}
+		CAttributeList& operator=(const CAttributeList& rhs)
+		{
+			if (this != &rhs)
+			{
+				clear();
+				reserve(rhs.size());
+				for (const auto& attr : rhs)
+					push_back(attr);
+			}
+			return *this;
+		}
+		CAttributeList(CAttributeList&& rhs) noexcept
+		{
+			Take(rhs);
+		}
+		CAttributeList& operator=(CAttributeList&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				clear();
+				Release();
+				Take(rhs);
+			}
+			return *this;
+		}
+		~CAttributeList()
+		{
+			clear();
+			Release();
+		}
+
+	public:
+		size_t size() const { Load(); return m_size; }
+		size_t capacity() const { Load(); return m_capacity; }
+		bool empty() const { Load(); return 0 == m_size; }
+		Attribute* data() { Load(); return m_data; }
+		const Attribute* data() const { Load(); return m_data; }
+		iterator begin() { Load(); return m_data; }
+		iterator end() { Load(); return m_data + m_size; }
+		const_iterator begin() const { Load(); return m_data; }
+		const_iterator end() const { Load(); return m_data + m_size; }
+		Attribute& front() { Load(); return m_data[0]; }
+		const Attribute& front() const { Load(); return m_data[0]; }
+		Attribute& back() { Load(); return m_data[m_size - 1]; }
+		const Attribute& back() const { Load(); return m_data[m_size - 1]; }
+		Attribute& operator[](const size_t index) { Load(); return m_data[index]; }
+		const Attribute& operator[](const size_t index) const { Load(); return m_data[index]; }
+		Attribute& at(const size_t index)
+		{
+			Load();
+			if (index >= m_size)
+				throw std::out_of_range("CAttributeList::at");
+			return m_data[index];
+		}
+		const Attribute& at(const size_t index) const { return const_cast<CAttributeList*>(this)->at(index); }
+
+		void push_back(const Attribute& attr) { emplace_back(attr); }
+		void push_back(Attribute&& attr) { emplace_back(std::move(attr)); }
+		template <typename... Args>
+		Attribute& emplace_back(Args&&... args)
+		{
+			Load();
+			if (m_size == m_capacity)
+			{
+				// args may refer to an attribute of this list
+				Attribute attr(std::forward<Args>(args)...);
+				reserve(m_capacity * 2);
+				return *::new (static_cast<void*>(m_data + m_size++)) Attribute(std::move(attr));
+			}
+			return *::new (static_cast<void*>(m_data + m_size++)) Attribute(std::forward<Args>(args)...);
+		}
+		void reserve(const size_t capacity)
+		{
+			Load();
+			if (capacity <= m_capacity)
+				return;
+			Attribute* data = static_cast<Attribute*>(::operator new(capacity * sizeof(Attribute), std::align_val_t{ alignof(Attribute) }));
+			for (size_t i = 0; i < m_size; ++i)
+			{
+				::new (static_cast<void*>(data + i)) Attribute(std::move(m_data[i]));
+				m_data[i].~Attribute();
+			}
+			Release();
+			m_data = data;
+			m_capacity = capacity;
+		}
+		void clear()
+		{
+			for (size_t i = 0; i < m_size; ++i)
+				m_data[i].~Attribute();
+			m_size = 0;
+			if (IsPending())
+				m_capacity = inline_count;
+		}
+
+		// add the attributes of the opening tag section of data which starts at index, after the name;
+		// return the index of the '>' which ends the tag, or data.size()
+		size_t Parse(std::string_view data, const size_t index, const AttributeSource source)
+		{
+			std::string buffer{};	// of the decoded values
+			return ScanAttributes(data, index, [this, source, &buffer](std::string_view key, std::string_view value, const char quote)
+				{
+					// a known key is interned as a view of its lowercase name in attribute_names,
+					// other keys are kept as written since SVG keys like viewBox are case sensitive
+					const AttributeId id{ GetAttributeId(key) };
+					CDomString name{ AttributeId::unknown != id ? CDomString::View(attribute_names[static_cast<size_t>(id)]) :
+						source.m_views ? CDomString::View(key) : CDomString(key) };
+					if (source.m_decode)
+					{
+						if (const std::string_view decoded{ DecodeEntities(value, buffer) }; decoded.data() != value.data())
+						{
+							emplace_back(std::move(name), CDomString(decoded), quote, id);
+							return;
+						}
+					}
+					emplace_back(std::move(name), source.m_views ? CDomString::View(value) : CDomString(value), quote, id);
+				});
+		}
+
+		// the attributes are parsed from section at the first access, the characters viewed by
+		// section must outlive the list; the list must be empty
+		void SetPending(std::string_view section, const AttributeSource source)
+		{
+			if (m_size || !IsInline())
+				return;
+			::new (static_cast<void*>(m_inline)) Pending{ section, source };
+			m_capacity = 0;
+		}
+		bool IsPending() const { return 0 == m_capacity; }
+
+	private:
+		static constexpr size_t loading{ static_cast<size_t>(-1) };
+		struct Pending
+		{
+			std::string_view m_section{};
+			AttributeSource m_source{};
+		};
+		static_assert(sizeof(Pending) <= sizeof(Attribute) * inline_count && std::is_trivially_destructible_v<Pending>);
+
+		// const accessors parse a pending list too: readers of a const tree may do it at the same time, the
+		// first one parses while the others wait for m_capacity, which is zero while the list is pending and
+		// loading while it is parsed
+		void Load() const
+		{
+			std::atomic_ref<size_t> state{ const_cast<CAttributeList*>(this)->m_capacity };
+			size_t capacity{ state.load(std::memory_order_acquire) };
+			if (0 == capacity && state.compare_exchange_strong(capacity, loading, std::memory_order_acquire))
+			{
+				try
+				{
+					capacity = const_cast<CAttributeList*>(this)->ParsePending();
+				}
+				catch (...)
+				{
+					state.store(0, std::memory_order_release);
+					state.notify_all();
+					throw;
+				}
+				state.store(capacity, std::memory_order_release);
+				state.notify_all();
+				return;
+			}
+			while (loading == capacity)
+			{
+				state.wait(loading, std::memory_order_acquire);
+				capacity = state.load(std::memory_order_acquire);
+			}
+		}
+		// parse the pending section into this list, return its capacity which the caller stores last
+		size_t ParsePending()
+		{
+			const Pending pending{ *std::launder(reinterpret_cast<const Pending*>(m_inline)) };
+			CAttributeList parsed{};
+			parsed.Parse(pending.m_section, 0, pending.m_source);
+			m_size = parsed.m_size;
+			if (parsed.IsInline())
+			{
+				for (size_t i = 0; i < parsed.m_size; ++i)
+					::new (static_cast<void*>(GetInline() + i)) Attribute(std::move(parsed.m_data[i]));
+				parsed.clear();
+				return inline_count;
+			}
+			m_data = parsed.m_data;
+			const size_t capacity{ parsed.m_capacity };
+			parsed.m_data = parsed.GetInline();
+			parsed.m_size = 0;
+			parsed.m_capacity = inline_count;
+			return capacity;
+		}
+
+	private:
+		Attribute* GetInline() { return std::launder(reinterpret_cast<Attribute*>(m_inline)); }
+		bool IsInline() const { return reinterpret_cast<const std::byte*>(m_data) == m_inline; }
+		// free the heap storage, the list must be empty
+		void Release()
+		{
+			if (!IsInline())
+				::operator delete(m_data, std::align_val_t{ alignof(Attribute) });
+			m_data = GetInline();
+			m_capacity = inline_count;
+		}
+		// this list is empty and inline, rhs is left empty
+		void Take(CAttributeList& rhs)
+		{
+			if (rhs.IsPending())
+			{
+				const Pending pending{ *std::launder(reinterpret_cast<const Pending*>(rhs.m_inline)) };
+				SetPending(pending.m_section, pending.m_source);
+				rhs.m_capacity = inline_count;
+			}
+			else if (rhs.IsInline())
+			{
+				for (auto& attr : rhs)
+					push_back(std::move(attr));
+				rhs.clear();
+			}
+			else
+			{
+				m_data = rhs.m_data;
+				m_size = rhs.m_size;
+				m_capacity = rhs.m_capacity;
+				rhs.m_data = rhs.GetInline();
+				rhs.m_size = 0;
+				rhs.m_capacity = inline_count;
+			}
+		}
+
+	private:
+		alignas(Attribute) std::byte m_inline[sizeof(Attribute) * inline_count];
+		Attribute* m_data{ reinterpret_cast<Attribute*>(m_inline) };
+		size_t m_size{};
+		size_t m_capacity{ inline_count };
+	};
+
+	enum class DataFormat : uint8_t
+	{
+		indented = 0,	// one tag per line, indented with tabs
+		compact			// no indentation and no new line
+	};
+
+	class CTagArena;
+
+	enum class TagOrder : uint8_t
+	{
+		pre = 0,	// a tag before the tags below it
+		post		// a tag after the tags below it
+	};
+
+	template <TagOrder Order>
+	class CTagIterator;
+	class CAncestorIterator;
+	template <typename Iterator>
+	class CTagRange;
+
+	struct Tag
+	{
+	public:
+		Tag() = default;
+		Tag(const std::string& name)
+			: m_name(name)
+			, m_id(GetTagId(m_name))
+		{
+		}
+		Tag(const std::string& name, const std::string& value)
+			: m_name(name)
+			, m_id(GetTagId(m_name))
+			, m_value(value)
+		{
+		}
+		Tag(const std::string& name, const std::string& value, const std::vector<Attribute>& attributes)
+			: m_name(name)
+			, m_id(GetTagId(m_name))
+			, m_value(value)
+			, m_attributes(attributes)
+		{
+		}
+		Tag(const std::string& name, const std::vector<Attribute>& attributes)
+			: m_name(name)
+			, m_id(GetTagId(m_name))
+			, m_attributes(attributes)
+		{
+		}
+		Tag(std::string&& name)
+			: m_name(std::move(name))
+			, m_id(GetTagId(m_name))
+		{
+		}
+		Tag(std::string&& name, std::string&& value)
+			: m_name(std::move(name))
+			, m_id(GetTagId(m_name))
+			, m_value(std::move(value))
+		{
+		}
+		Tag(std::string&& name, std::string&& value, std::vector<Attribute>&& attributes)
+			: m_name(std::move(name))
+			, m_id(GetTagId(m_name))
+			, m_value(std::move(value))
+			, m_attributes(std::move(attributes))
+		{
+		}
+		Tag(std::string&& name, std::vector<Attribute>&& attributes)
+			: m_name(std::move(name))
+			, m_id(GetTagId(m_name))
+			, m_attributes(std::move(attributes))
+		{
+		}
+		Tag(const Tag& rhs)
+			: m_name(rhs.m_name)
+			, m_id(rhs.m_id)
+			, m_value(rhs.m_value)
+			, m_attributes(rhs.m_attributes)
+			, m_childs(rhs.m_childs)
+			, m_parent(rhs.m_parent)
+			, m_childIndex(rhs.m_childIndex)
+			, m_arena(rhs.m_arena)
+		{
+		}
+		Tag& operator=(const Tag& rhs)
+		{
+			if (this != &rhs)
+			{
+				m_parent = rhs.m_parent;
+				m_childIndex = rhs.m_childIndex;
+				m_arena = rhs.m_arena;
+				m_name = rhs.m_name;
+				m_id = rhs.m_id;
+				m_value = rhs.m_value;
+				m_childs = rhs.m_childs;
+				m_attributes = rhs.m_attributes;
+			}
+			return *this;
+		}
+		Tag(Tag&& rhs) noexcept
+			: m_name(std::move(rhs.m_name))
+			, m_id(rhs.m_id)
+			, m_value(std::move(rhs.m_value))
+			, m_attributes(std::move(rhs.m_attributes))
+			, m_childs(std::move(rhs.m_childs))
+			, m_parent(std::move(rhs.m_parent))
+			, m_childIndex(rhs.m_childIndex)
+			, m_arena(std::move(rhs.m_arena))
+		{
+			rhs.m_parent = nullptr;
+			rhs.m_arena = nullptr;
+		}
+		Tag& operator=(Tag&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				m_parent = std::move(rhs.m_parent);
+				m_childIndex = rhs.m_childIndex;
+				m_arena = std::move(rhs.m_arena);
+				m_name = std::move(rhs.m_name);
+				m_id = rhs.m_id;
+				m_value = std::move(rhs.m_value);
+				m_childs = std::move(rhs.m_childs);
+				m_attributes = std::move(rhs.m_attributes);
+
+				rhs.m_parent = nullptr;
+				rhs.m_arena = nullptr;
+			}
+			return *this;
+		}
+		~Tag() = default;
+
+	public:
+		CDomString m_name{};
+		TagId m_id{ TagId::unknown };	// id of m_name, kept in sync by SetName
+		CDomString m_value{};
+		CAttributeList m_attributes{};	// known keys are interned lowercase
+		std::vector<Tag*> m_childs{};	// owned by the arena of the tree, not by the parent
+		Tag* m_parent{};
+		size_t m_childIndex{};			// position in the childs of m_parent, or in the top tags of the tree
+		CTagArena* m_arena{};			// arena which owns this tag, null for a tag outside of a tree
+
+	public:
+		// SetName, AddAttributes, SetAttribute and AddChild change what the lookup indexes of the tree hold,
+		// they invalidate them through the arena
+		void SetName(std::string_view name);
+		void AddAttributes(const std::vector<Attribute>& attributes);
+		void AddAttributes(std::vector<Attribute>&& attributes);
+		// keys are case insensitive, a known key is found by its id;
+		// GetAttribute returns an empty value if the tag doesn't have the attribute
+		const Attribute* FindAttribute(const AttributeId id) const
+		{
+			for (const auto& attr : m_attributes)
+			{
+				if (id == attr.m_id)
+					return &attr;
+			}
+			return nullptr;
+		}
+		const Attribute* FindAttribute(std::string_view key) const
+		{
+			if (const AttributeId id = GetAttributeId(key); AttributeId::unknown != id)
+				return FindAttribute(id);
+			for (const auto& attr : m_attributes)
+			{
+				if (AttributeId::unknown == attr.m_id && EqualsNoCase(attr.m_key, key))
+					return &attr;
+			}
+			return nullptr;
+		}
+		std::string_view GetAttribute(const AttributeId id) const
+		{
+			const Attribute* attr = FindAttribute(id);
+			return attr ? attr->m_value.view() : std::string_view{};
+		}
+		std::string_view GetAttribute(std::string_view key) const
+		{
+			const Attribute* attr = FindAttribute(key);
+			return attr ? attr->m_value.view() : std::string_view{};
+		}
+		bool HasAttribute(const AttributeId id) const { return nullptr != FindAttribute(id); }
+		bool HasAttribute(std::string_view key) const { return nullptr != FindAttribute(key); }
+		Attribute* FindAttribute(const AttributeId id) { return const_cast<Attribute*>(std::as_const(*this).FindAttribute(id)); }
+		Attribute* FindAttribute(std::string_view key) { return const_cast<Attribute*>(std::as_const(*this).FindAttribute(key)); }
+		// change the value of the attribute, or add it if the tag doesn't have it
+		void SetAttribute(std::string_view key, std::string_view value);
+		void SetValue(const std::string& text)
+		{
+			m_value = text;
+		}
+		void SetValue(std::string&& text)
+		{
+			m_value = std::move(text);
+		}
+		// the childs are allocated in the arena of this tag,
+		// return nullptr if this tag doesn't belong to a tree;
+		// AddChild(Tag&) adds a copy of tag and of the tags below it, tag is left as it is,
+		// AddChild(Tag&&) takes the tags below tag, those of another tree are copied
+		Tag* AddText(const std::string& text);
+		Tag* AddText(std::string&& text);
+		Tag* AddChild(Tag& tag);
+		Tag* AddChild(Tag&& tag);
+		// markup of this tag (outer) or of its content (inner), the cost depends on the subtree only
+		std::string GetOuterHtml(const DataFormat format = DataFormat::compact) const;
+		std::string GetInnerHtml(const DataFormat format = DataFormat::compact) const;
+		template <typename Sink>
+		void WriteOuterHtml(Sink& sink, const DataFormat format = DataFormat::compact) const;
+		template <typename Sink>
+		void WriteInnerHtml(Sink& sink, const DataFormat format = DataFormat::compact) const;
+		// lazy views without recursion, the tags below this tag in document order (this tag excluded),
+		// the childs, the parents up to the top tag and the siblings after this tag;
+		// a top tag of a tree doesn't know its siblings, FollowingSiblings is empty for it
+		CTagRange<CTagIterator<TagOrder::pre>> Descendants() const;
+		CTagRange<CTagIterator<TagOrder::post>> DescendantsPostOrder() const;
+		std::span<Tag* const> Childs() const { return m_childs; }
+		CTagRange<CAncestorIterator> Ancestors() const;
+		std::span<Tag* const> FollowingSiblings() const;
+		// the position in the childs of m_parent, m_childIndex unless the childs were changed by hand;
+		// the tag must have a parent
+		size_t GetChildIndex() const
+		{
+			const std::vector<Tag*>& siblings{ m_parent->m_childs };
+			if (m_childIndex < siblings.size() && this == siblings[m_childIndex])
+				return m_childIndex;
+			return static_cast<size_t>(std::find(siblings.begin(), siblings.end(), this) - siblings.begin());
+		}
+
+	private:
+		Tag* CopyTree(const Tag& tag) const;
+		Tag* Link(Tag* child);
+	};
+
+	// bump allocator owning all the tags of a CDomTree, tags are released all at once with the arena
+	class CTagArena
+	{
+	public:
+		CTagArena() = default;
+		CTagArena(const CTagArena& rhs) = delete;
+		CTagArena& operator=(const CTagArena& rhs) = delete;
+		~CTagArena() { Clear(); }
+
+	public:
+		template <typename... Args>
+		Tag* Create(Args&&... args)
+		{
+			if (m_blocks.empty())
+			{
+				m_blocks.push_back(std::unique_ptr<Block>(new Block));
+			}
+			else if (block_size == m_used)
+			{
+				if (++m_blockIndex == m_blocks.size())
+					m_blocks.push_back(std::unique_ptr<Block>(new Block));
+				m_used = 0;
+			}
+			Tag* tag = ::new (static_cast<void*>(m_blocks[m_blockIndex]->m_data + m_used * sizeof(Tag))) Tag(std::forward<Args>(args)...);
+			m_used++;
+			tag->m_arena = this;
+			return tag;
+		}
+		// destroy all the tags, the memory blocks are kept for the next tags
+		void Clear()
+		{
+			for (size_t i = 0; i < m_blocks.size() && i <= m_blockIndex; ++i)
+			{
+				const size_t count = (i == m_blockIndex ? m_used : block_size);
+				Tag* tags = std::launder(reinterpret_cast<Tag*>(m_blocks[i]->m_data));
+				for (size_t j = 0; j < count; ++j)
+					tags[j].~Tag();
+			}
+			m_blockIndex = 0;
+			m_used = 0;
+			m_version++;
+		}
+		size_t GetCount() const { return (m_blocks.empty() ? 0 : m_blockIndex * block_size + m_used); }
+		// changed by the Tag methods which change names, attributes or childs, the indexes built
+		// from the tags are valid while the version is the same
+		uint64_t GetVersion() const { return m_version; }
+		void BumpVersion() { m_version++; }
+		// the texts and attribute values of the tags hold decoded characters, CTagWriter escapes them
+		void SetDecoded(const bool decoded) { m_decoded = decoded; }
+		bool IsDecoded() const { return m_decoded; }
+
+	private:
+		static constexpr size_t block_size{ 256 };
+		struct Block
+		{
+			alignas(Tag) std::byte m_data[sizeof(Tag) * block_size];
+		};
+
+	private:
+		std::vector<std::unique_ptr<Block>> m_blocks{};
+		size_t m_blockIndex{};	// block where the next tag is created
+		size_t m_used{};		// tags created in m_blocks[m_blockIndex]
+		uint64_t m_version{};
+		bool m_decoded{ false };
+	};
+
+	inline void Tag::SetName(std::string_view name)
+	{
+		m_name = name;
+		m_id = GetTagId(name);
+		if (m_arena)
+			m_arena->BumpVersion();
+	}
+	inline void Tag::AddAttributes(const std::vector<Attribute>& attributes)
+	{
+		std::copy(std::begin(attributes), std::end(attributes), std::back_inserter(m_attributes));
+		if (m_arena)
+			m_arena->BumpVersion();
+	}
+	inline void Tag::AddAttributes(std::vector<Attribute>&& attributes)
+	{
+		if (m_attributes.empty())
+		{
+			m_attributes = std::move(attributes);
+		}
+		else
+		{
+			m_attributes.reserve(m_attributes.size() + attributes.size());
+			std::move(std::begin(attributes), std::end(attributes), std::back_inserter(m_attributes));
+			attributes.clear();
+		}
+		if (m_arena)
+			m_arena->BumpVersion();
+	}
+
+	inline void Tag::SetAttribute(std::string_view key, std::string_view value)
+	{
+		if (Attribute* attr = FindAttribute(key))
+		{
+			attr->m_value = value;
+		}
+		else if (const AttributeId id = GetAttributeId(key); AttributeId::unknown != id)
+		{
+			m_attributes.emplace_back(CDomString::View(attribute_names[static_cast<size_t>(id)]), value, '\"', id);
+		}
+		else
+		{
+			m_attributes.emplace_back(key, value, '\"', id);
+		}
+		if (m_arena)
+			m_arena->BumpVersion();
+	}
+
+	inline Tag* Tag::AddText(const std::string& text)
+	{
+		if (!m_arena)
+			return nullptr;
+		Tag* tag = m_arena->Create();
+		tag->m_value = text;
+		tag->m_parent = this;
+		tag->m_childIndex = m_childs.size();
+		m_childs.push_back(tag);
+		return tag;
+	}
+	inline Tag* Tag::AddText(std::string&& text)
+	{
+		return AddText(static_cast<const std::string&>(text));
+	}
+	inline Tag* Tag::AddChild(Tag& tag)
+	{
+		if (!m_arena)
+			return nullptr;
+		return Link(CopyTree(tag));
+	}
+	inline Tag* Tag::AddChild(Tag&& tag)
+	{
+		if (!m_arena)
+			return nullptr;
+		Tag* child = m_arena->Create(std::move(tag));
+		for (size_t i = 0; i < child->m_childs.size(); ++i)
+		{
+			Tag*& below = child->m_childs[i];
+			if (m_arena != below->m_arena)
+				below = CopyTree(*below);
+			below->m_parent = child;
+			below->m_childIndex = i;
+		}
+		return Link(child);
+	}
+	// a copy of tag and of the tags below it in the arena of this tag, without a parent
+	inline Tag* Tag::CopyTree(const Tag& tag) const
+	{
+		Tag* copy = m_arena->Create(tag);
+		copy->m_parent = nullptr;
+		copy->m_childIndex = 0;
+		// a copy holds the childs of its source until they are replaced by their copies
+		std::vector<Tag*> pending{ copy };
+		while (!pending.empty())
+		{
+			Tag* parent = pending.back();
+			pending.pop_back();
+			for (size_t i = 0; i < parent->m_childs.size(); ++i)
+			{
+				Tag* child = m_arena->Create(*parent->m_childs[i]);
+				child->m_parent = parent;
+				child->m_childIndex = i;
+				parent->m_childs[i] = child;
+				pending.push_back(child);
+			}
+		}
+		return copy;
+	}
+	// child becomes the last child of this tag
+	inline Tag* Tag::Link(Tag* child)
+	{
+		child->m_parent = this;
+		child->m_childIndex = m_childs.size();
+		m_childs.push_back(child);
+		m_arena->BumpVersion();
+		return child;
+	}
+
+	// false for the text, comment, doctype and processing instruction tags
+	inline bool IsElement(const Tag& tag)
+	{
+		return !tag.m_name.empty() && '!' != tag.m_name.front() && '?' != tag.m_name.front();
+	}
+
+	// iterator over the tags below a tag, or below the top tags of a tree, in document order;
+	// it follows m_parent and finds the next sibling with m_childIndex, so a step allocates nothing
+	// and the depth of the tree doesn't matter
+	template <TagOrder Order>
+	class CTagIterator
+	{
+	public:
+		using iterator_concept = std::forward_iterator_tag;
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Tag*;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = Tag*;
+
+	public:
+		CTagIterator() = default;
+		// the first tag below root, root is null for the top tags
+		CTagIterator(const Tag* root, std::span<Tag* const> top)
+			: m_root(root)
+			, m_top(top)
+		{
+			const auto childs = GetChilds(root);
+			if (childs.empty())
+				return;
+			m_tag = childs.front();
+			if constexpr (TagOrder::post == Order)
+				m_tag = GetFirstLeaf(m_tag);
+		}
+		Tag* operator*() const { return m_tag; }
+		CTagIterator& operator++()
+		{
+			if constexpr (TagOrder::pre == Order)
+				m_tag = GetNextPreOrder();
+			else
+				m_tag = GetNextPostOrder();
+			return *this;
+		}
+		CTagIterator operator++(int)
+		{
+			CTagIterator it{ *this };
+			++*this;
+			return it;
+		}
+		bool operator==(const CTagIterator& rhs) const { return m_tag == rhs.m_tag; }
+
+	private:
+		std::span<Tag* const> GetChilds(const Tag* tag) const
+		{
+			return tag ? std::span<Tag* const>(tag->m_childs) : m_top;
+		}
+		Tag* GetNextSibling(const Tag* tag) const
+		{
+			const auto siblings = GetChilds(tag->m_parent);
+			size_t index{ tag->m_childIndex };
+			if (index >= siblings.size() || tag != siblings[index])	// the childs were changed by hand
+				index = static_cast<size_t>(std::find(siblings.begin(), siblings.end(), tag) - siblings.begin());
+			return (index + 1 < siblings.size() ? siblings[index + 1] : nullptr);
+		}
+		static Tag* GetFirstLeaf(Tag* tag)
+		{
+			while (!tag->m_childs.empty())
+				tag = tag->m_childs.front();
+			return tag;
+		}
+		Tag* GetNextPreOrder() const
+		{
+			if (!m_tag->m_childs.empty())
+				return m_tag->m_childs.front();
+			for (const Tag* tag = m_tag; tag && tag != m_root; tag = tag->m_parent)
+			{
+				if (Tag* next = GetNextSibling(tag))
+					return next;
+			}
+			return nullptr;
+		}
+		Tag* GetNextPostOrder() const
+		{
+			if (Tag* next = GetNextSibling(m_tag))
+				return GetFirstLeaf(next);
+			return (m_tag->m_parent == m_root ? nullptr : m_tag->m_parent);
+		}
+
+	private:
+		Tag* m_tag{};
+		const Tag* m_root{};
+		std::span<Tag* const> m_top{};
+	};
+
+	// iterator over the parents of a tag, up to the top tag
+	class CAncestorIterator
+	{
+	public:
+		using iterator_concept = std::forward_iterator_tag;
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Tag*;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = Tag*;
+
+	public:
+		CAncestorIterator() = default;
+		explicit CAncestorIterator(Tag* tag)
+			: m_tag(tag)
+		{
+		}
+		Tag* operator*() const { return m_tag; }
+		CAncestorIterator& operator++()
+		{
+			m_tag = m_tag->m_parent;
+			return *this;
+		}
+		CAncestorIterator operator++(int)
+		{
+			CAncestorIterator it{ *this };
+			++*this;
+			return it;
+		}
+		bool operator==(const CAncestorIterator& rhs) const { return m_tag == rhs.m_tag; }
+
+	private:
+		Tag* m_tag{};
+	};
+
+	// view over the tags of an iterator, the default iterator is the end
+	template <typename Iterator>
+	class CTagRange : public std::ranges::view_interface<CTagRange<Iterator>>
+	{
+	public:
+		CTagRange() = default;
+		explicit CTagRange(const Iterator& first)
+			: m_first(first)
+		{
+		}
+		Iterator begin() const { return m_first; }
+		Iterator end() const { return {}; }
+
+	private:
+		Iterator m_first{};
+	};
+
+	inline CTagRange<CTagIterator<TagOrder::pre>> Tag::Descendants() const
+	{
+		return CTagRange{ CTagIterator<TagOrder::pre>{ this, {} } };
+	}
+	inline CTagRange<CTagIterator<TagOrder::post>> Tag::DescendantsPostOrder() const
+	{
+		return CTagRange{ CTagIterator<TagOrder::post>{ this, {} } };
+	}
+	inline CTagRange<CAncestorIterator> Tag::Ancestors() const
+	{
+		return CTagRange{ CAncestorIterator{ m_parent } };
+	}
+	inline std::span<Tag* const> Tag::FollowingSiblings() const
+	{
+		if (!m_parent)
+			return {};
+		const std::span<Tag* const> siblings{ m_parent->m_childs };
+		return siblings.subspan(std::min(GetChildIndex() + 1, siblings.size()));
+	}
+
+	// sinks of CTagWriter, a sink is any type with Write(std::string_view)
+	struct StringSink
+	{
+		std::string& m_text;
+		void Write(std::string_view text) { m_text.append(text); }
+	};
+
+	struct StreamSink
+	{
+		std::ostream& m_stream;
+		void Write(std::string_view text) { m_stream.write(text.data(), static_cast<std::streamsize>(text.size())); }
+	};
+
+	struct FileSink
+	{
+		std::FILE* m_file{};
+		void Write(std::string_view text) { std::fwrite(text.data(), 1, text.size(), m_file); }
+	};
+
+	template <typename Callback>
+	struct CallbackSink
+	{
+		Callback m_callback;
+		void Write(std::string_view text) { m_callback(text); }
+	};
+
+	// count the characters only, CTagWriter doesn't buffer for it
+	struct CountingSink
+	{
+		size_t m_size{};
+		void Write(std::string_view text) { m_size += text.size(); }
+	};
+
+	// writes the markup of tags through a fixed size buffer, the sink gets the text in blocks of
+	// the buffer size (a longer text is passed as it is), so the memory used doesn't depend on the output
+	template <typename Sink>
+	class CTagWriter
+	{
+	public:
+		explicit CTagWriter(Sink& sink)
+			: m_sink(sink)
+		{
+			m_path.reserve(64);
+		}
+		CTagWriter(const CTagWriter& rhs) = delete;
+		CTagWriter& operator=(const CTagWriter& rhs) = delete;
+		~CTagWriter() { Flush(); }
+
+	public:
+		// the indented markup of GetData
+		void WriteData(const std::vector<Tag*>& tags, const size_t level = 0)
+		{
+			for (const auto& it : tags)
+			{
+				m_escape = IsDecoded(*it);
+				WriteTag(*it, level);
+			}
+		}
+
+		// the markup without indentation
+		void WriteCompact(const std::vector<Tag*>& tags)
+		{
+			for (const auto& it : tags)
+			{
+				m_escape = IsDecoded(*it);
+				WriteCompactTag(*it);
+			}
+		}
+
+		// the markup of one tag
+		void WriteOuter(const Tag& tag, const DataFormat format)
+		{
+			m_escape = IsDecoded(tag);
+			if (DataFormat::compact == format)
+				WriteCompactTag(tag);
+			else
+				WriteTag(tag, 0);
+		}
+
+		// the markup of the content of one tag
+		void WriteInner(const Tag& tag, const DataFormat format)
+		{
+			m_escape = IsDecoded(tag);
+			if (tag.m_childs.empty())
+			{
+				WriteCharacters(TrimRight(tag.m_value), &tag);
+				return;
+			}
+			for (const auto& it : tag.m_childs)
+			{
+				if (DataFormat::compact == format)
+				{
+					WriteCompactTag(*it);
+				}
+				else if (it->m_name.empty())	// is value
+				{
+					if (m_count)
+						Write('\n');
+					WriteCharacters(TrimRight(it->m_value), &tag);
+				}
+				else
+				{
+					WriteTag(*it, 0);
+				}
+			}
+		}
+
+		void Write(std::string_view text)
+		{
+			m_count += text.size();
+			if constexpr (std::is_same_v<Sink, CountingSink>)
+				return;
+			if (text.size() > m_buffer.size() - m_used)
+			{
+				Flush();
+				if (text.size() >= m_buffer.size())
+				{
+					m_sink.Write(text);
+					return;
+				}
+			}
+			std::copy(text.begin(), text.end(), m_buffer.data() + m_used);
+			m_used += text.size();
+		}
+		void Write(const char c)
+		{
+			if constexpr (std::is_same_v<Sink, CountingSink>)
+			{
+				m_count++;
+				return;
+			}
+			if (m_buffer.size() == m_used)
+				Flush();
+			m_buffer[m_used++] = c;
+			m_count++;
+		}
+		void Flush()
+		{
+			if constexpr (std::is_same_v<Sink, CountingSink>)
+				m_sink.m_size = m_count;
+			else if (m_used)
+				m_sink.Write(std::string_view(m_buffer.data(), m_used));
+			m_used = 0;
+		}
+		// characters written so far
+		size_t GetCount() const { return m_count; }
+
+	private:
+		// onOpen(tag, parent, level) is called in document order, it returns true to write the tags below tag
+		// and then onClose(tag, level); the open tags are kept in m_path, not on the call stack,
+		// the current one is kept in locals since every Write may change any memory
+		template <typename Open, typename Close>
+		void Walk(const Tag& top, const size_t level, Open&& onOpen, Close&& onClose)
+		{
+			if (!onOpen(top, nullptr, level))
+				return;
+			const size_t base{ m_path.size() };
+			const Tag* tag{ &top };
+			auto it = top.m_childs.begin();
+			auto end = top.m_childs.end();
+			size_t depth{ level + 1 };
+			while (true)
+			{
+				if (end != it)
+				{
+					const Tag* child = *it++;
+					if (onOpen(*child, tag, depth))
+					{
+						m_path.push_back({ tag, static_cast<size_t>(it - tag->m_childs.begin()) });
+						tag = child;
+						it = child->m_childs.begin();
+						end = child->m_childs.end();
+						depth++;
+					}
+					continue;
+				}
+
+				onClose(*tag, --depth);
+				if (base == m_path.size())
+					return;
+				tag = m_path.back().first;
+				it = tag->m_childs.begin() + m_path.back().second;
+				end = tag->m_childs.end();
+				m_path.pop_back();
+			}
+		}
+
+		void WriteTag(const Tag& top, const size_t level)
+		{
+			Walk(top, level, [this](const Tag& tag, const Tag* parent, const size_t depth)
+				{
+					if (tag.m_name.empty())	// is value
+					{
+						if (parent)
+							WriteText(tag, *parent, depth);
+						return false;
+					}
+					if (!IsElement(tag))
+					{
+						if (m_count)
+							Write('\n');
+						WriteIndent(depth);
+						Write('<');
+						Write(tag.m_name);
+						Write('>');
+						return false;
+					}
+					WriteName(tag, depth);
+					if (tag.m_childs.empty())
+						WriteCharacters(TrimRight(tag.m_value), &tag);
+					return true;
+				}, [this](const Tag& tag, const size_t depth)
+				{
+					WriteClose(tag, depth);
+				});
+		}
+
+		void WriteName(const Tag& tag, const size_t level)
+		{
+			if (m_count)
+				Write('\n');
+			WriteIndent(level);
+			Write('<');
+			Write(tag.m_name);
+			WriteAttributes(tag);
+
+			if (GetTagTraits(tag.m_id).m_selfClosing)
+				Write('/');
+			Write('>');
+		}
+
+		// a text child of parent, at the level of the childs of parent
+		void WriteText(const Tag& text, const Tag& parent, const size_t level)
+		{
+			if (1 == parent.m_childs.size() && !GetTagTraits(parent.m_id).m_multiLine)
+			{
+				WriteCharacters(TrimRight(text.m_value), &parent);
+			}
+			else
+			{
+				Write('\n');
+				WriteIndent(level);
+				WriteCharacters(TrimRight(text.m_value), &parent);
+			}
+		}
+
+		void WriteAttributes(const Tag& tag)
+		{
+			for (const auto& attr : tag.m_attributes)
+			{
+				Write(' ');
+				Write(attr.m_key);
+				Write('=');
+				Write(attr.m_quote);
+				if (m_escape)
+					WriteEscaped(attr.m_value, attr.m_quote);
+				else
+					Write(attr.m_value);
+				Write(attr.m_quote);
+			}
+		}
+
+		// a text of owner, escaped if the tree holds decoded characters unless owner is a script or a style
+		void WriteCharacters(std::string_view text, const Tag* owner)
+		{
+			if (m_escape && !(owner && GetTagTraits(owner->m_id).m_multiLine))
+				WriteEscaped(text, '\0');
+			else
+				Write(text);
+		}
+
+		// text with & < > escaped, or & and quote for an attribute value
+		void WriteEscaped(std::string_view text, const char quote)
+		{
+			size_t written{};
+			for (size_t pos = FindFirstOf<'&', '<', '>', '\"', '\''>(text, 0); pos < text.size();
+				pos = FindFirstOf<'&', '<', '>', '\"', '\''>(text, pos + 1))
+			{
+				std::string_view reference{};
+				if ('&' == text[pos])
+					reference = "&amp;";
+				else if (!quote && '<' == text[pos])
+					reference = "&lt;";
+				else if (!quote && '>' == text[pos])
+					reference = "&gt;";
+				else if (quote == text[pos])
+					reference = ('\"' == quote ? "&quot;" : "&#39;");
+				else
+					continue;
+				Write(text.substr(written, pos - written));
+				Write(reference);
+				written = pos + 1;
+			}
+			Write(text.substr(written));
+		}
+
+		static bool IsDecoded(const Tag& tag)
+		{
+			return tag.m_arena && tag.m_arena->IsDecoded();
+		}
+
+		void WriteClose(const Tag& tag, const size_t level)
+		{
+			if (!GetTagTraits(tag.m_id).m_selfClosing)
+			{
+				if (tag.m_childs.size() > 1 || (!tag.m_childs.empty() && !tag.m_childs.front()->m_name.empty()) ||
+					GetTagTraits(tag.m_id).m_multiLine)
+				{
+					Write('\n');
+					WriteIndent(level);
+				}
+				Write("</");
+				Write(tag.m_name);
+				Write('>');
+			}
+		}
+
+		void WriteCompactTag(const Tag& top)
+		{
+			Walk(top, 0, [this](const Tag& tag, const Tag* parent, const size_t)
+				{
+					if (tag.m_name.empty())	// is value
+					{
+						WriteCharacters(TrimRight(tag.m_value), parent);
+						return false;
+					}
+
+					Write('<');
+					Write(tag.m_name);
+					if (!IsElement(tag))
+					{
+						Write('>');
+						return false;
+					}
+					WriteAttributes(tag);
+					if (GetTagTraits(tag.m_id).m_selfClosing)
+					{
+						Write("/>");
+						return false;
+					}
+					Write('>');
+					if (tag.m_childs.empty())
+						WriteCharacters(TrimRight(tag.m_value), &tag);
+					return true;
+				}, [this](const Tag& tag, const size_t)
+				{
+					Write("</");
+					Write(tag.m_name);
+					Write('>');
+				});
+		}
+
+		void WriteIndent(size_t level)
+		{
+			constexpr std::string_view tabs{ "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t" };
+			for (; level > tabs.size(); level -= tabs.size())
+				Write(tabs);
+			Write(tabs.substr(0, level));
+		}
+
+		static std::string_view TrimRight(std::string_view text)
+		{
+			return text.substr(0, text.find_last_not_of(whitespace) + 1);
+		}
+
+	private:
+		Sink& m_sink;
+		std::array<char, 4096> m_buffer;
+		size_t m_used{};
+		size_t m_count{};
+		bool m_escape{ false };		// the tags hold decoded characters
+		std::vector<std::pair<const Tag*, size_t>> m_path{};	// open tags and their next child while writing
+	};
+
+	template <typename Sink>
+	void Tag::WriteOuterHtml(Sink& sink, const DataFormat format) const
+	{
+		CTagWriter<Sink> writer{ sink };
+		writer.WriteOuter(*this, format);
+	}
+	template <typename Sink>
+	void Tag::WriteInnerHtml(Sink& sink, const DataFormat format) const
+	{
+		CTagWriter<Sink> writer{ sink };
+		writer.WriteInner(*this, format);
+	}
+	inline std::string Tag::GetOuterHtml(const DataFormat format) const
+	{
+		CountingSink counter{};
+		WriteOuterHtml(counter, format);
+		std::string out{};
+		out.reserve(counter.m_size);
+		StringSink sink{ out };
+		WriteOuterHtml(sink, format);
+		return out;
+	}
+	inline std::string Tag::GetInnerHtml(const DataFormat format) const
+	{
+		CountingSink counter{};
+		WriteInnerHtml(counter, format);
+		std::string out{};
+		out.reserve(counter.m_size);
+		StringSink sink{ out };
+		WriteInnerHtml(sink, format);
+		return out;
+	}
+
+	// event tokenizer, it reports the tokens of a document to Handler without building any tag;
+	// Handler implements only the events it needs, all the views point into the tokenized data:
+	//	OnOpenTag(std::string_view name, TagId id)
+	//	OnAttribute(std::string_view key, std::string_view value, char quote)	after OnOpenTag
+	//	OnCloseTag(std::string_view name, TagId id)		also right after a self closing tag
+	//	OnText(std::string_view text)					leading white spaces skipped, script, style and svg content is one text
+	//	OnComment(std::string_view text)				between "<!--" and "-->"
+	//	OnDoctype(std::string_view text)				between '<' and '>': "!DOCTYPE html", "?xml ..."
+	// the tokens are reported as they are, there is no tree correction
+	template <typename Handler>
+	class CTokenizer
+	{
+	public:
+		explicit CTokenizer(Handler& handler)
+			: m_handler(handler)
+		{
+		}
+
+	public:
+		void Parse(std::string_view data)
+		{
+			m_data = data;
+			m_index = 0;
+			while (m_index < m_data.length())
+			{
+				m_index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_index);
+				if (m_index >= m_data.length())
+					break;
+
+				if ('<' == m_data[m_index])
+				{
+					ParseTag();
+				}
+				else
+				{
+					const size_t start{ m_index };
+					m_index = FindFirstOf<'<'>(m_data, m_index);
+					Text(m_data.substr(start, m_index - start));
+				}
+			}
+		}
+
+	private:
+		void ParseTag()
+		{
+			m_index++;
+			if (m_index >= m_data.length())
+				return;
+
+			switch (m_data[m_index])
+			{
+			case '/':
+				ParseClosingTag();
+				break;
+			case '!':
+				if (m_data.substr(m_index, 3) == "!--")
+				{
+					ParseComment();
+					break;
+				}
+				[[fallthrough]];
+			case '?':
+				ParseDoctype();
+				break;
+			default:
+				ParseOpeningTag();
+			}
+		}
+
+		void ParseOpeningTag()
+		{
+			m_index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_index);
+			const size_t start{ m_index };
+			m_index = FindFirstOf<' ', '\n', '\r', '\t', '>', '/'>(m_data, m_index);
+			const std::string_view name{ m_data.substr(start, m_index - start) };
+			const TagId id{ GetTagId(name) };
+
+			if constexpr (requires { m_handler.OnOpenTag(name, id); })
+				m_handler.OnOpenTag(name, id);
+			m_index = ScanAttributes(m_data, m_index, [this](std::string_view key, std::string_view value, const char quote)
+				{
+					if constexpr (requires { m_handler.OnAttribute(key, value, quote); })
+						m_handler.OnAttribute(key, value, quote);
+				});
+
+			const bool selfClosing{ GetTagTraits(id).m_selfClosing || (m_index < m_data.length() && '/' == m_data[m_index - 1]) };
+			m_index++;
+			if (selfClosing)
+			{
+				CloseTag(name, id);
+				return;
+			}
+
+			// the content of script, style and svg is not tokenized
+			if (GetTagTraits(id).m_multiLine)
+			{
+				const size_t textStart{ FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_index) };
+				m_index = FindClosingTag(m_data, textStart, tag_names[static_cast<size_t>(id)].substr(0, 3));
+				if (m_index + 5 >= m_data.length())
+					m_index = m_data.length();
+				if (textStart < m_index)
+					Text(m_data.substr(textStart, m_index - textStart));
+			}
+		}
+
+		void ParseClosingTag()
+		{
+			m_index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_index + 1);
+			const size_t start{ m_index };
+			m_index = FindFirstOf<' ', '\n', '\r', '\t', '>'>(m_data, m_index);
+			const std::string_view name{ m_data.substr(start, m_index - start) };
+			m_index = FindFirstOf<'>'>(m_data, m_index) + 1;
+			CloseTag(name, GetTagId(name));
+		}
+
+		void ParseComment()
+		{
+			const size_t start{ m_index + 3 };
+			const size_t end{ std::min(m_data.find("-->", start), m_data.length()) };
+			m_index = std::min(end + 3, m_data.length());
+			if constexpr (requires { m_handler.OnComment(m_data); })
+				m_handler.OnComment(m_data.substr(start, end - start));
+		}
+
+		void ParseDoctype()
+		{
+			const size_t start{ m_index };
+			m_index = FindFirstOf<'>'>(m_data, m_index);
+			if constexpr (requires { m_handler.OnDoctype(m_data); })
+				m_handler.OnDoctype(m_data.substr(start, m_index - start));
+			m_index++;
+		}
+
+		void CloseTag(std::string_view name, const TagId id)
+		{
+			if constexpr (requires { m_handler.OnCloseTag(name, id); })
+				m_handler.OnCloseTag(name, id);
+		}
+
+		void Text(std::string_view text)
+		{
+			if constexpr (requires { m_handler.OnText(text); })
+				m_handler.OnText(text);
+		}
+
+	private:
+		Handler& m_handler;
+		std::string_view m_data{};
+		size_t m_index{};
+	};
+
+	// read only memory mapping of a whole file
+	class CFileMapping
+	{
+	public:
+		CFileMapping() = default;
+		explicit CFileMapping(const std::filesystem::path& path)
+		{
+			Open(path);
+		}
+		CFileMapping(const CFileMapping& rhs) = delete;
+		CFileMapping& operator=(const CFileMapping& rhs) = delete;
+		~CFileMapping() { Close(); }
+
+	public:
+		// return false if the file can't be opened or mapped, an empty file is mapped to an empty view
+		bool Open(const std::filesystem::path& path)
+		{
+			Close();
+#if defined(_WIN32)
+			const HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (INVALID_HANDLE_VALUE == file)
+				return false;
+			LARGE_INTEGER size{};
+			if (::GetFileSizeEx(file, &size) && 0 == size.QuadPart)
+			{
+				::CloseHandle(file);
+				m_open = true;
+				return true;
+			}
+			// the view keeps the mapping and the file alive, the handles are not needed after
+			const HANDLE mapping = (0 < size.QuadPart ? ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr);
+			const void* data = (mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr);
+			if (mapping)
+				::CloseHandle(mapping);
+			::CloseHandle(file);
+			if (!data)
+				return false;
+			m_data = static_cast<const char*>(data);
+			m_size = static_cast<size_t>(size.QuadPart);
+#else
+			const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (-1 == file)
+				return false;
+			struct stat info{};
+			if (-1 == ::fstat(file, &info))
+			{
+				::close(file);
+				return false;
+			}
+			if (0 == info.st_size)
+			{
+				::close(file);
+				m_open = true;
+				return true;
+			}
+			void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			::close(file);	// the mapping keeps the file alive
+			if (MAP_FAILED == data)
+				return false;
+			::posix_madvise(data, static_cast<size_t>(info.st_size), POSIX_MADV_SEQUENTIAL);
+			m_data = static_cast<const char*>(data);
+			m_size = static_cast<size_t>(info.st_size);
+#endif
+			m_open = true;
+			return true;
+		}
+		void Close()
+		{
+			if (m_data)
+			{
+#if defined(_WIN32)
+				::UnmapViewOfFile(m_data);
+#else
+				::munmap(const_cast<char*>(m_data), m_size);
+#endif
+			}
+			m_data = nullptr;
+			m_size = 0;
+			m_open = false;
+		}
+		bool IsOpen() const { return m_open; }
+		std::string_view GetData() const { return { m_data ? m_data : "", m_size }; }
+
+	private:
+		const char* m_data{};
+		size_t m_size{};
+		bool m_open{ false };
+	};
+
+	// what the parser makes of the content of script, style and svg elements and of the comments
+	enum class ContentFilter
+	{
+		keep,	// the content is one text tag, a comment is a tag named "!--...--"
+		empty,	// the element has no child, a comment is the placeholder "!----"
+		skip	// no tag is created, not even the element
+	};
+
+	struct ParseOptions
+	{
+		// names, text and attribute values are views into the parsed buffer instead of owned copies,
+		// so the tags are valid only while the CDomTree which parsed them is alive
+		bool m_zeroCopy{ false };
+		// the tags are added to the per name lists of GetElementsByTagName while they are parsed,
+		// otherwise the lists are built by a walk of the tree at the first call
+		bool m_indexTags{ false };
+		// the character references (&amp; &nbsp; &#233; ...) of texts and attribute values are decoded
+		// while parsing, the texts of script and style are kept as they are; the writers escape them again
+		bool m_decodeEntities{ false };
+		// the charset of the documents, unknown to detect it from a BOM or a <meta>; an undeclared document
+		// which isn't valid UTF-8 (a fed one in its first 1024 characters) is read as windows-1252. The tags
+		// are always UTF-8: a legacy charset is transcoded and invalid UTF-8 is replaced with U+FFFD, into a
+		// copy of the document
+		Charset m_charset{ Charset::unknown };
+		// the attributes of a tag are parsed at their first access, the parser only finds where the tag ends;
+		// until then they view the parsed buffer, so the data given to ParseView must outlive the unparsed
+		// attributes (the buffers of Parse and ParseFile are kept by the tree until Clear); a copied tag
+		// has its attributes parsed, and a fed document is parsed at once. Threads which only read a const
+		// tree may access the same unparsed attributes at once, the first access parses them and the others wait
+		bool m_lazyAttributes{ false };
+		// filters for text extraction, the filtered content is passed over by the search of its end and never copied
+		ContentFilter m_scriptContent{ ContentFilter::keep };
+		ContentFilter m_styleContent{ ContentFilter::keep };
+		ContentFilter m_svgContent{ ContentFilter::keep };
+		ContentFilter m_comments{ ContentFilter::keep };
+	};
+
+	class CFlatTree;
+
+	class CDomTree
+	{
+	public:
+		CDomTree() = default;
+		explicit CDomTree(const ParseOptions& options)
+			: m_options(options)
+		{
+		}
+		CDomTree(const CDomTree& rhs) = delete;
+		CDomTree& operator=(const CDomTree& rhs) = delete;
+		CDomTree(CDomTree&& rhs) noexcept
+			: m_options(std::move(rhs.m_options))
+			, m_buffer(std::move(rhs.m_buffer))
+			, m_mapping(std::move(rhs.m_mapping))
+			, m_retainedBuffers(std::move(rhs.m_retainedBuffers))
+			, m_retainedMappings(std::move(rhs.m_retainedMappings))
+			, m_data(std::move(rhs.m_data))
+			, m_stream(std::move(rhs.m_stream))
+			, m_undecoded(std::move(rhs.m_undecoded))
+			, m_streaming(std::move(rhs.m_streaming))
+			, m_streamEnded(std::move(rhs.m_streamEnded))
+			, m_sniffed(rhs.m_sniffed)
+			, m_arena(std::move(rhs.m_arena))
+			, m_tags(std::move(rhs.m_tags))
+			, m_tagIndex(std::move(rhs.m_tagIndex))
+			, m_attributeIndex(std::move(rhs.m_attributeIndex))
+			, m_bufferIndex(std::move(rhs.m_bufferIndex))
+			, m_openTags(std::move(rhs.m_openTags))
+			, m_decoded(std::move(rhs.m_decoded))
+			, m_charset(rhs.m_charset)
+			, m_currentTag(std::move(rhs.m_currentTag))
+			, m_svg(std::move(rhs.m_svg))
+			, m_style(std::move(rhs.m_style))
+			, m_script(std::move(rhs.m_script))
+			, m_filtered(std::move(rhs.m_filtered))
+		{
+			rhs.m_currentTag = nullptr;
+			rhs.m_tagIndex.Clear();
+			rhs.m_attributeIndex.Clear();
+			rhs.m_openTags.Clear();
+			rhs.m_data = {};
+			rhs.m_streaming = false;
+			rhs.m_streamEnded = false;
+			rhs.m_bufferIndex = 0;
+			rhs.m_svg = false;
+			rhs.m_style = false;
+			rhs.m_script = false;
+			rhs.m_filtered = false;
+		}
+		CDomTree& operator=(CDomTree&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				m_options = std::move(rhs.m_options);
+				m_buffer = std::move(rhs.m_buffer);
+				m_mapping = std::move(rhs.m_mapping);
+				m_retainedBuffers = std::move(rhs.m_retainedBuffers);
+				m_retainedMappings = std::move(rhs.m_retainedMappings);
+				m_data = std::move(rhs.m_data);
+				m_stream = std::move(rhs.m_stream);
+				m_undecoded = std::move(rhs.m_undecoded);
+				m_streaming = std::move(rhs.m_streaming);
+				m_streamEnded = std::move(rhs.m_streamEnded);
+				m_sniffed = rhs.m_sniffed;
+				m_arena = std::move(rhs.m_arena);
+				m_tags = std::move(rhs.m_tags);
+				m_tagIndex = std::move(rhs.m_tagIndex);
+				m_attributeIndex = std::move(rhs.m_attributeIndex);
+				m_bufferIndex = std::move(rhs.m_bufferIndex);
+				m_openTags = std::move(rhs.m_openTags);
+				m_decoded = std::move(rhs.m_decoded);
+				m_charset = rhs.m_charset;
+				m_currentTag = std::move(rhs.m_currentTag);
+				m_svg = std::move(rhs.m_svg);
+				m_style = std::move(rhs.m_style);
+				m_script = std::move(rhs.m_script);
+				m_filtered = std::move(rhs.m_filtered);
+
+				rhs.m_currentTag = nullptr;
+				rhs.m_tagIndex.Clear();
+				rhs.m_attributeIndex.Clear();
+				rhs.m_openTags.Clear();
+				rhs.m_data = {};
+				rhs.m_streaming = false;
+				rhs.m_streamEnded = false;
+				rhs.m_bufferIndex = 0;
+				rhs.m_svg = false;
+				rhs.m_style = false;
+				rhs.m_script = false;
+				rhs.m_filtered = false;
+			}
+			return *this;
+		}
+		~CDomTree() = default;
+
+	public:
+		std::vector<Tag*>& GetTags() { return m_tags; }
+		const std::vector<Tag*>& GetTags() const { return m_tags; }
+		// all the tags in document order, without recursion
+		CTagRange<CTagIterator<TagOrder::pre>> Descendants() const { return CTagRange{ CTagIterator<TagOrder::pre>{ nullptr, m_tags } }; }
+		CTagRange<CTagIterator<TagOrder::post>> DescendantsPostOrder() const { return CTagRange{ CTagIterator<TagOrder::post>{ nullptr, m_tags } }; }
+		const ParseOptions& GetOptions() const { return m_options; }
+		// the charset the document was read in, its tags are UTF-8
+		Charset GetDocumentCharset() const { return m_charset; }
+		void SetOptions(const ParseOptions& options) { m_options = options; }
+		// the tags are added to the tags of the previous documents, call Clear to start a new tree
+		void Parse(const std::string& data)
+		{
+			RetainDocument();
+			m_buffer = std::make_unique<const std::string>(data);
+			ParseBuffer(*m_buffer);
+		}
+
+		void Parse(std::string&& data)
+		{
+			RetainDocument();
+			m_buffer = std::make_unique<const std::string>(std::move(data));
+			ParseBuffer(*m_buffer);
+		}
+
+		// parse straight from a read only mapping of the file, which is kept with the tree like the
+		// buffer given to Parse, so m_zeroCopy tags view the mapping; return false if the file can't be read
+		bool ParseFile(const std::filesystem::path& path)
+		{
+			auto mapping = std::make_unique<CFileMapping>(path);
+			if (!mapping->IsOpen())
+				return false;
+			RetainDocument();
+			m_mapping = std::move(mapping);
+			ParseBuffer(m_mapping->GetData());
+			return true;
+		}
+
+		// parse data kept alive by the caller, it isn't copied so m_zeroCopy tags view it
+		// (unless it has to be transcoded to UTF-8)
+		void ParseView(std::string_view data)
+		{
+			RetainDocument();
+			ParseBuffer(data);
+		}
+
+		// tags which view the tables of flat, built from a tree or loaded from a snapshot, without parsing, so
+		// CTagWriter, CSelector, CXPath and the tag iterators take a snapshot; flat, and the memory given to its
+		// LoadSnapshotView, must outlive the tags. The texts are decoded if m_decodeEntities was set for the
+		// tree flat was built from, which the options of this tree must tell
+		void ViewFlatTree(const CFlatTree& flat);
+
+		// release the tags and the parsed document, the arena memory is kept for the next parse
+		void Clear()
+		{
+			m_tags.clear();
+			m_tagIndex.Clear();
+			m_attributeIndex.Clear();
+			if (m_arena)
+				m_arena->Clear();
+			m_buffer.reset();
+			m_mapping.reset();
+			m_retainedBuffers.clear();
+			m_retainedMappings.clear();
+			m_data = {};
+			m_stream.clear();
+			m_undecoded.clear();
+			m_streaming = false;
+			m_streamEnded = false;
+			m_sniffed = false;
+			m_openTags.Clear();
+			m_charset = Charset::unknown;
+			m_bufferIndex = 0;
+			m_currentTag = nullptr;
+			m_svg = m_style = m_script = m_filtered = false;
+		}
+
+		// parse the document as it arrives, the chunks may split tags, attributes or texts anywhere;
+		// the tags are always owned copies, m_zeroCopy doesn't apply to a fed document;
+		// the charset is detected once the first 1024 characters are fed (an undeclared document is
+		// read as windows-1252 if they aren't UTF-8), then the chunks are decoded like a parsed document:
+		// a UTF-8 sequence split between two chunks is completed by the next one
+		void Feed(std::string_view chunk)
+		{
+			if (!m_streaming)
+			{
+				if (!m_arena)
+					m_arena = std::make_unique<CTagArena>();
+				m_arena->SetDecoded(m_options.m_decodeEntities);
+				m_stream.clear();
+				m_undecoded.clear();
+				m_bufferIndex = 0;
+				m_streaming = true;
+				m_streamEnded = false;
+				m_sniffed = false;
+				m_charset = m_options.m_charset;
+				PrepareTagIndex();
+			}
+			if (m_streamEnded)
+				return;
+
+			if (!m_sniffed)
+			{
+				// the first characters are kept until the BOM, or the <meta> of an unknown charset, can be seen
+				m_undecoded.append(chunk);
+				if (m_undecoded.size() < (Charset::unknown == m_charset ? charset_sniff_size : utf8_bom.size()))
+					return;
+				SniffFedCharset(false);
+				chunk = {};
+			}
+
+			m_attributeIndex.m_valid = false;
+			DecodeFed(chunk, false);
+			m_data = m_stream;
+			while (m_bufferIndex < m_data.length() && IsNextTokenComplete())
+			{
+				if (!ParseNextToken())
+				{
+					m_streamEnded = true;
+					break;
+				}
+			}
+
+			// drop the parsed characters, a few are kept behind for the comment end lookup
+			const size_t parsed{ std::min(m_bufferIndex, m_stream.length()) };
+			if (parsed > stream_lookahead)
+			{
+				m_stream.erase(0, parsed - stream_lookahead);
+				m_bufferIndex -= parsed - stream_lookahead;
+				m_data = m_stream;
+			}
+		}
+
+		// parse what is left from the fed chunks
+		void Finish()
+		{
+			if (!m_streaming)
+				return;
+
+			if (!m_streamEnded)
+			{
+				if (!m_sniffed)
+					SniffFedCharset(true);
+				DecodeFed({}, true);
+			}
+			m_data = m_stream;
+			m_attributeIndex.m_valid = false;
+			while (!m_streamEnded && m_bufferIndex < m_data.length())
+			{
+				if (!ParseNextToken())
+					break;
+			}
+			m_streaming = false;
+			m_stream.clear();
+			m_stream.shrink_to_fit();
+			m_undecoded.clear();
+			m_data = {};
+			m_bufferIndex = 0;
+		}
+
+		// the size of the text is computed first, so the string is allocated once
+		std::string GetData(const DataFormat format = DataFormat::indented) const
+		{
+			CountingSink counter{};
+			WriteData(counter, format);
+			std::string out{};
+			out.reserve(counter.m_size);
+			StringSink sink{ out };
+			WriteData(sink, format);
+			return out;
+		}
+
+		// write the text of GetData to sink, any type with Write(std::string_view): StringSink,
+		// StreamSink, FileSink, CallbackSink, CountingSink
+		template <typename Sink>
+		void WriteData(Sink& sink, const DataFormat format = DataFormat::indented) const
+		{
+			CTagWriter<Sink> writer{ sink };
+			if (DataFormat::compact == format)
+			{
+				writer.WriteCompact(m_tags);
+				return;
+			}
+			writer.WriteData(m_tags);
+			writer.Write('\n');
+		}
+
+		// the tags with this name in document order, the name is case insensitive
+		std::span<Tag* const> GetElementsByTagName(std::string_view name) const
+		{
+			const TagId id{ GetTagId(name) };
+			if (TagId::unknown != id)
+				return GetElementsByTagId(id);
+
+			EnsureTagIndex();
+			std::string lower(name);
+			std::transform(lower.begin(), lower.end(), lower.begin(), ToLower);
+			const auto it = m_tagIndex.m_unknown.find(lower);
+			if (m_tagIndex.m_unknown.end() == it)
+				return {};
+			return it->second;
+		}
+		std::span<Tag* const> GetElementsByTagId(const TagId id) const
+		{
+			EnsureTagIndex();
+			return m_tagIndex.m_known[static_cast<size_t>(id)];
+		}
+
+		// the first tag in document order with this id, nullptr if there is none; the id and class
+		// indexes are built at the first lookup and again after the tags are changed through their methods
+		Tag* GetElementById(std::string_view id) const
+		{
+			EnsureAttributeIndex();
+			const auto it = m_attributeIndex.m_ids.find(id);
+			return (m_attributeIndex.m_ids.end() == it ? nullptr : it->second);
+		}
+		// the tags having this class in document order
+		std::span<Tag* const> GetElementsByClassName(std::string_view name) const
+		{
+			EnsureAttributeIndex();
+			const auto it = m_attributeIndex.m_classes.find(name);
+			if (m_attributeIndex.m_classes.end() == it)
+				return {};
+			return it->second;
+		}
+
+	private:
+		// the tags of the previous documents may view their buffer or mapping, which are kept until Clear
+		void RetainDocument()
+		{
+			if (!m_tags.empty())
+			{
+				if (m_buffer)
+					m_retainedBuffers.push_back(std::move(m_buffer));
+				if (m_mapping)
+					m_retainedMappings.push_back(std::move(m_mapping));
+			}
+			m_buffer.reset();
+			m_mapping.reset();
+		}
+
+		void ParseBuffer(std::string_view data)
+		{
+			if (!m_arena)
+				m_arena = std::make_unique<CTagArena>();
+			m_arena->SetDecoded(m_options.m_decodeEntities);
+			m_data = PrepareInput(data);
+			m_bufferIndex = 0;
+			PrepareTagIndex();
+			m_attributeIndex.m_valid = false;
+			while (m_bufferIndex < m_data.length())
 			{
 				if (!ParseNextToken())
 					break;
 			}
 		}
 
-		bool ParseNextToken()
+		// the document as UTF-8, a BOM is skipped; a legacy charset or invalid UTF-8 is transcoded
+		// into m_buffer in one pass before tokenizing, the ASCII runs are copied as they are
+		// the charset of a fed document from its first characters in m_undecoded, ended if they are the whole document
+		void SniffFedCharset(const bool ended)
+		{
+			m_sniffed = true;
+			if (Charset::unknown == m_charset)
+				m_charset = DetectCharset(m_undecoded);
+			if (Charset::unknown == m_charset)
+			{
+				const std::string_view head{ m_undecoded };
+				const size_t cut{ ended ? 0 : GetTruncatedUtf8Length(head) };
+				m_charset = (IsValidUtf8(head.substr(0, head.size() - cut)) ? Charset::utf8 : Charset::windows_1252);
+			}
+			if (m_undecoded.starts_with(utf8_bom))
+				m_undecoded.erase(0, utf8_bom.size());
+		}
+		// append the fed characters to m_stream as UTF-8, invalid UTF-8 is replaced with U+FFFD;
+		// a UTF-8 sequence cut by the end of chunk is kept in m_undecoded until the next chunk or the end
+		void DecodeFed(std::string_view chunk, const bool ended)
+		{
+			std::string joined{};
+			if (!m_undecoded.empty())
+			{
+				joined = std::move(m_undecoded);
+				m_undecoded.clear();
+				joined.append(chunk);
+				chunk = joined;
+			}
+			const size_t cut{ chunk.size() - (Charset::utf8 == m_charset && !ended ? GetTruncatedUtf8Length(chunk) : 0) };
+			TranscodeToUtf8(chunk.substr(0, cut), m_charset, m_stream);
+			m_undecoded.assign(chunk.substr(cut));
+		}
+
+		std::string_view PrepareInput(std::string_view data)
+		{
+			m_charset = (Charset::unknown == m_options.m_charset ? DetectCharset(data) : m_options.m_charset);
+			if (data.starts_with(utf8_bom))
+				data.remove_prefix(utf8_bom.size());
+			if (Charset::utf8 == m_charset || Charset::unknown == m_charset)
+			{
+				const size_t invalid{ FindInvalidUtf8(data) };
+				if (data.size() == invalid)
+				{
+					m_charset = Charset::utf8;
+					return data;
+				}
+				if (Charset::unknown == m_charset)
+					m_charset = Charset::windows_1252;
+			}
+
+			std::string text{};
+			text.reserve(data.size() + data.size() / 8);
+			TranscodeToUtf8(data, m_charset, text);
+			m_buffer = std::make_unique<const std::string>(std::move(text));
+			m_mapping.reset();
+			return *m_buffer;
+		}
+
+		bool ParseNextToken()
+		{
+			if (m_bufferIndex >= m_data.length())
+				return false;
+
+			if (!m_currentTag || !m_script || !m_style || !m_svg)
+				SkipWhiteSpaces();
+
+			if (m_svg || m_filtered)
+				return ParseValue();
+
+			if (m_bufferIndex < m_data.length() && '<' == m_data[m_bufferIndex])
+				return ParseTag();
+			else
+				return ParseValue();
+		}
+
+		bool ParseTag()
+		{
+			if (m_bufferIndex >= m_data.length())
+				return false;
+
+			m_bufferIndex++;
+
+			if (m_bufferIndex >= m_data.length())
+				return false;
+
+			switch (m_data[m_bufferIndex])
+			{
+			case '/':
+				m_bufferIndex++;
+				ParseClosingTag();
+				break;
+			case '!':
+			case '?':
+				if ('!' == m_data[m_bufferIndex]
+					&& m_bufferIndex < m_data.length() - 3
+					&& '-' == m_data[m_bufferIndex + 1]
+					&& '-' == m_data[m_bufferIndex + 2])
+					ParseCommentTag();
+				else
+					ParseSpecialTag();
+				break;
+			default:
+				if (!ParseOpeningTag())
+					return false;
+			}
+
+			return true;
+		}
+
+		bool ParseValue()
+		{
+			if (m_filtered)
+			{
+				SkipToClosingTag(GetRawContentEnd());
+				m_script = m_style = m_svg = m_filtered = false;
+				return true;
+			}
+
+			if (!m_currentTag)
+				return false;
+
+			const size_t start{ m_bufferIndex };
+			bool raw{ true };	// script, style and svg content
+
+			do
+			{
+				if (!m_script && !m_style && !m_svg)
+				{
+					m_bufferIndex = FindFirstOf<'<'>(m_data, m_bufferIndex);
+					raw = false;
+					break;
+				}
+
+				if (m_script)
+				{
+					SkipToClosingTag("scr");
+					m_script = false;
+					break;
+				}
+
+				if (m_style)
+				{
+					SkipToClosingTag("sty");
+					m_style = false;
+					break;
+				}
+
+				if (m_svg)
+				{
+					SkipToClosingTag("svg");
+					m_svg = false;
+				}
+			} while (false);
+
+			Tag* tag = m_arena->Create();
+			const std::string_view text{ m_data.substr(start, m_bufferIndex - start) };
+			tag->m_value = raw ? MakeString(text) : MakeText(text);
+			AppendTag(m_currentTag, tag);
+
+			return true;
+		}
+
+		bool ParseSpecialTag()
+		{
+			Tag* tag = m_arena->Create();
+
+			const size_t start{ m_bufferIndex };
+			m_bufferIndex = FindFirstOf<'>'>(m_data, m_bufferIndex);
+			tag->m_name = MakeString(m_data.substr(start, m_bufferIndex - start));
+
+			if (m_tags.empty() || !m_currentTag)
+				AppendTag(nullptr, tag);
+			else
+				AppendTag(m_currentTag, tag);
+
+			if (m_bufferIndex >= m_data.length() || '>' == m_data[m_bufferIndex])
+				m_bufferIndex++;
+
+			return true;
+		}
+
+		bool ParseCommentTag()
+		{
+			const size_t start{ m_bufferIndex };
+			const std::string_view data{ m_data.substr(0, m_data.length() - 3) };
+			while ((m_bufferIndex = FindFirstOf<'>'>(data, m_bufferIndex)) < data.length()
+				&& !('-' == m_data[m_bufferIndex - 1]
+					&& '-' == m_data[m_bufferIndex - 2]))
+				m_bufferIndex++;
+
+			if (ContentFilter::skip != m_options.m_comments)
+			{
+				Tag* tag = m_arena->Create();
+				tag->m_name = ContentFilter::keep == m_options.m_comments ?
+					MakeString(m_data.substr(start, m_bufferIndex - start)) : CDomString::View("!----");
+
+				if (m_tags.empty() || !m_currentTag)
+					AppendTag(nullptr, tag);
+				else
+					AppendTag(m_currentTag, tag);
+			}
+
+			if (m_bufferIndex >= m_data.length() || '>' == m_data[m_bufferIndex])
+				m_bufferIndex++;
+
+			return true;
+		}
+
+		bool ParseOpeningTag()
+		{
+			SkipWhiteSpaces();
+
+			// parse tag name
+			const size_t start{ m_bufferIndex };
+			m_bufferIndex = FindFirstOf<' ', '\n', '\r', '\t', '>', '/'>(m_data, m_bufferIndex);
+			const std::string_view name{ m_data.substr(start, m_bufferIndex - start) };
+			const TagId id{ GetTagId(name) };
+
+			if (GetTagTraits(id).m_nonValid)
+			{
+				SkipCurrentTag();
+				return true;
+			}
+
+			// a skipped element leaves no tag open, so its closing tag is ignored
+			const ContentFilter filter{ GetContentFilter(id) };
+			if (ContentFilter::skip == filter)
+			{
+				m_bufferIndex = ScanAttributes(m_data, m_bufferIndex, [](std::string_view, std::string_view, const char) {});
+				if (m_bufferIndex < m_data.length())
+					m_bufferIndex++;
+				FilterContent(id);
+				return true;
+			}
+
+			const bool isSelfClosingTag = GetTagTraits(id).m_selfClosing;
+
+			Tag* tag = m_arena->Create();
+			tag->m_name = MakeLowerString(name);
+			tag->m_id = id;
+
+			if (m_tags.empty() || !m_currentTag)
+			{
+				AppendTag(nullptr, tag);
+				m_currentTag = tag;
+			}
+			else
+			{
+				if (GetTagRules(id).m_closes)
+					CloseImpliedTags(id);
+
+				if (m_currentTag)
+				{
+					AppendTag(m_currentTag, tag);							// add the local tag to the childs of m_currentTag
+					m_currentTag = tag;										// setup m_currentTag as local tag
+					SetupMultiLineTags();
+				}
+				else	// the correction closed the top tag
+				{
+					AppendTag(nullptr, tag);
+					m_currentTag = tag;
+				}
+			}
+			if (ContentFilter::empty == filter)
+				FilterContent(id);
+			if (m_tagIndex.m_valid)
+				m_tagIndex.Add(tag);
+
+			ParseAttributes();
+
+			if (isSelfClosingTag)
+				m_currentTag = m_openTags.Top();
+			else
+				m_openTags.Push(tag);
+
+			if (m_bufferIndex >= m_data.length() || '>' == m_data[m_bufferIndex])
+				m_bufferIndex++;
+
+			return true;
+		}
+
+		void ParseClosingTag()
+		{
+			SkipWhiteSpaces();
+
+			const size_t start{ m_bufferIndex };
+			m_bufferIndex = FindFirstOf<' ', '\n', '\r', '\t', '>'>(m_data, m_bufferIndex);
+			const std::string_view name{ m_data.substr(start, m_bufferIndex - start) };
+			const TagId id{ GetTagId(name) };
+
+			if (m_bufferIndex >= m_data.length() || '>' == m_data[m_bufferIndex])
+				m_bufferIndex++;
+
+			if (GetTagTraits(id).m_nonValid)
+				return;
+
+			// close the nearest open tag with this name, the closing tag is ignored if there is none in scope
+			const TagRules& rules{ GetTagRules(id) };
+			const size_t scopeStart{ m_openTags.GetScopeStart(rules.m_closeScope & ~rules.m_mask) };
+			const std::vector<size_t>& positions{ m_openTags.GetPositions(id) };
+			for (size_t index = positions.size(); index-- > 0 && positions[index] >= scopeStart;)
+			{
+				if (TagId::unknown != id || EqualsLower(name, m_openTags.At(positions[index])->m_name.view()))
+				{
+					CloseOpenTags(positions[index]);
+					return;
+				}
+			}
+		}
+		// close the open tags implied by the opening tag id
+		void CloseImpliedTags(const TagId id)
+		{
+			const TagRules& rules{ GetTagRules(id) };
+			uint32_t closes{ rules.m_closes & m_openTags.GetOpenRules() };
+			if (!closes)
+				return;
+
+			// the outermost open tag of m_closes above the nearest scope tag
+			const size_t start{ m_openTags.GetScopeStart(rules.m_openScope & ~rules.m_closes) };
+			size_t closed{ m_openTags.GetSize() };
+			for (; closes; closes &= closes - 1)
+			{
+				const std::vector<size_t>& positions{ m_openTags.GetPositions(rule_tags[std::countr_zero(closes)]) };
+				if (const auto it = std::lower_bound(positions.begin(), positions.end(), start); positions.end() != it)
+					closed = std::min(closed, *it);
+			}
+			if (closed < m_openTags.GetSize())
+				CloseOpenTags(closed);
+		}
+		// close the open tags from index to the top of the stack
+		void CloseOpenTags(const size_t index)
+		{
+			m_openTags.Resize(index);
+			m_currentTag = m_openTags.Top();
+		}
+
+		void ParseAttributes()
+		{
+			const AttributeSource source{ m_options.m_zeroCopy && !m_streaming, m_options.m_decodeEntities };
+			if (!m_options.m_lazyAttributes || m_streaming)
+			{
+				m_bufferIndex = m_currentTag->m_attributes.Parse(m_data, m_bufferIndex, source);
+				return;
+			}
+			// only the end of the tag is looked for, the section is parsed when the attributes are read
+			const size_t start{ m_bufferIndex };
+			m_bufferIndex = ScanAttributes(m_data, m_bufferIndex, [](std::string_view, std::string_view, const char) {});
+			if (m_bufferIndex > start)
+				m_currentTag->m_attributes.SetPending(m_data.substr(start, m_bufferIndex - start), source);
+		}
+
+		void SkipWhiteSpaces()
+		{
+			m_bufferIndex = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_bufferIndex);
+		}
+
+		// move to the closing tag which starts with "</" + name, name has 3 lowercase characters
+		void SkipToClosingTag(const std::string_view name)
+		{
+			m_bufferIndex = FindClosingTag(m_data, m_bufferIndex, name);
+		}
+
+		// true if the next token ends before the last stream_lookahead characters of the buffer,
+		// then parsing it now gives the same tags as parsing the whole document
+		bool IsNextTokenComplete() const
+		{
+			const size_t length{ m_data.length() };
+			const size_t start{ FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, m_bufferIndex) };
+			if (start + stream_lookahead >= length)
+				return false;
+
+			size_t end{ length };
+			if (m_svg)
+				end = FindClosingTag(m_data, start, "svg");
+			else if (m_filtered)
+				end = FindClosingTag(m_data, start, GetRawContentEnd());
+			else if ('<' == m_data[start])
+				end = FindTagEnd(start);
+			else if (!m_currentTag)
+				return true;	// a text outside of any tag ends the parsing
+			else if (m_script)
+				end = FindClosingTag(m_data, start, "scr");
+			else if (m_style)
+				end = FindClosingTag(m_data, start, "sty");
+			else
+				end = FindFirstOf<'<'>(m_data, start);
+
+			return end + stream_lookahead < length;
+		}
+
+		// return the position of the '>' which ends the tag starting at index, or the buffer length
+		size_t FindTagEnd(size_t index) const
+		{
+			index++;
+			switch (m_data[index])
+			{
+			case '/':
+				return FindFirstOf<'>'>(m_data, index);
+			case '!':
+				if ('-' == m_data[index + 1] && '-' == m_data[index + 2])
+				{
+					while ((index = FindFirstOf<'>'>(m_data, index)) < m_data.length()
+						&& !('-' == m_data[index - 1] && '-' == m_data[index - 2]))
+						index++;
+					return index;
+				}
+				[[fallthrough]];
+			case '?':
+				return FindFirstOf<'>'>(m_data, index);
+			default:
+				break;
+			}
+
+			index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_data, index);
+			const size_t start{ index };
+			index = FindFirstOf<' ', '\n', '\r', '\t', '>', '/'>(m_data, index);
+			if (GetTagTraits(GetTagId(m_data.substr(start, index - start))).m_nonValid)
+				return FindFirstOf<'>'>(m_data, index);
+			return ScanAttributes(m_data, index, [](std::string_view, std::string_view, const char) {});
+		}
+
+		// with m_indexTags the parser adds the tags to a valid index, otherwise the index is built when needed
+		void PrepareTagIndex()
+		{
+			if (m_options.m_indexTags)
+				EnsureTagIndex();
+			else
+				m_tagIndex.Clear();
+		}
+		void EnsureTagIndex() const
+		{
+			if (m_tagIndex.m_valid && GetVersion() == m_tagIndex.m_version)
+				return;
+			m_tagIndex.Clear();
+			m_tagIndex.m_version = GetVersion();
+			for (Tag* tag : Descendants())
+				m_tagIndex.Add(tag);
+			m_tagIndex.m_valid = true;
+		}
+		void EnsureAttributeIndex() const
+		{
+			if (m_attributeIndex.m_valid && GetVersion() == m_attributeIndex.m_version)
+				return;
+			m_attributeIndex.Clear();
+			m_attributeIndex.m_version = GetVersion();
+			for (Tag* tag : Descendants())
+			{
+				for (const auto& attr : tag->m_attributes)
+				{
+					if (AttributeId::id == attr.m_id)
+					{
+						m_attributeIndex.m_ids.try_emplace(attr.m_value.view(), tag);
+					}
+					else if (AttributeId::class_ == attr.m_id)
+					{
+						const std::string_view value{ attr.m_value.view() };
+						for (size_t start = FindFirstNotOf<' ', '\n', '\r', '\t'>(value, 0); start < value.size();)
+						{
+							const size_t end{ FindFirstOf<' ', '\n', '\r', '\t'>(value, start) };
+							auto& tags = m_attributeIndex.m_classes[value.substr(start, end - start)];
+							if (tags.empty() || tag != tags.back())
+								tags.push_back(tag);
+							start = FindFirstNotOf<' ', '\n', '\r', '\t'>(value, end);
+						}
+					}
+				}
+			}
+			m_attributeIndex.m_valid = true;
+		}
+		uint64_t GetVersion() const { return (m_arena ? m_arena->GetVersion() : 0); }
+
+		// append tag to the childs of parent, or to the top tags if parent is null
+		void AppendTag(Tag* parent, Tag* tag)
+		{
+			std::vector<Tag*>& siblings = (parent ? parent->m_childs : m_tags);
+			tag->m_parent = parent;
+			tag->m_childIndex = siblings.size();
+			siblings.push_back(tag);
+		}
+
+		// view into the parsed buffer or owned copy, depending on m_zeroCopy option
+		CDomString MakeString(std::string_view text) const
+		{
+			return (m_options.m_zeroCopy && !m_streaming) ? CDomString::View(text) : CDomString(text);
+		}
+		// texts, a text with decoded references is always a copy
+		CDomString MakeText(std::string_view text)
+		{
+			if (!m_options.m_decodeEntities)
+				return MakeString(text);
+			const std::string_view decoded{ DecodeEntities(text, m_decoded) };
+			return decoded.data() == text.data() ? MakeString(text) : CDomString(decoded);
+		}
+		// tag names are lowercase, only names which are not already lowercase are copied
+		CDomString MakeLowerString(std::string_view text) const
+		{
+			if (std::none_of(text.begin(), text.end(), [](const char c) { return c != std::tolower(c); }))
+				return MakeString(text);
+
+			std::string lower(text);
+			std::transform(lower.begin(), lower.end(), lower.begin(), [](const char c) { return static_cast<char>(std::tolower(c)); });
+			return CDomString(lower);
+		}
+
+	private:
+		static constexpr size_t stream_lookahead{ 8 };
+
+	private:
+		void SetupMultiLineTags()
+		{
+			m_script = m_style = m_svg = false;
+			switch (m_currentTag->m_id)
+			{
+			case TagId::script:
+				m_script = true;
+				break;
+			case TagId::style:
+				m_style = true;
+				break;
+			case TagId::svg:
+				m_svg = true;
+				break;
+			default:
+				break;
+			}
+		}
+		ContentFilter GetContentFilter(const TagId id) const
+		{
+			switch (id)
+			{
+			case TagId::script:
+				return m_options.m_scriptContent;
+			case TagId::style:
+				return m_options.m_styleContent;
+			case TagId::svg:
+				return m_options.m_svgContent;
+			default:
+				return ContentFilter::keep;
+			}
+		}
+		// the content of the script, style or svg tag id which starts now makes no tag
+		void FilterContent(const TagId id)
+		{
+			m_script = TagId::script == id;
+			m_style = TagId::style == id;
+			m_svg = TagId::svg == id;
+			m_filtered = true;
+		}
+		// the first characters of the name in the closing tag of the current multiline tag
+		std::string_view GetRawContentEnd() const
+		{
+			return m_script ? "scr" : m_style ? "sty" : "svg";
+		}
+		// skip the current tag
+		void SkipCurrentTag()
+		{
+			m_bufferIndex = FindFirstOf<'>'>(m_data, m_bufferIndex);
+			if (m_bufferIndex >= m_data.length() || '>' == m_data[m_bufferIndex])
+				m_bufferIndex++;
+		}
+
+	private:
+		// tags by name in document order
+		struct TagIndex
+		{
+			void Add(Tag* tag)
+			{
+				if (TagId::unknown != tag->m_id)
+					m_known[static_cast<size_t>(tag->m_id)].push_back(tag);
+				else if (!tag->m_name.empty() && '!' != tag->m_name.front() && '?' != tag->m_name.front())
+					m_unknown[tag->m_name.view()].push_back(tag);
+			}
+			void Clear()
+			{
+				for (auto& tags : m_known)
+					tags.clear();
+				m_unknown.clear();
+				m_valid = false;
+			}
+
+			std::array<std::vector<Tag*>, tag_count> m_known{};						// by TagId
+			std::unordered_map<std::string_view, std::vector<Tag*>> m_unknown{};	// by lowercase name
+			uint64_t m_version{};	// of the arena when the index was built
+			bool m_valid{ false };
+		};
+
+		// tags by id and by class, views on the attribute values
+		struct AttributeIndex
+		{
+			void Clear()
+			{
+				m_ids.clear();
+				m_classes.clear();
+				m_valid = false;
+			}
+
+			std::unordered_map<std::string_view, Tag*> m_ids{};
+			std::unordered_map<std::string_view, std::vector<Tag*>> m_classes{};
+			uint64_t m_version{};
+			bool m_valid{ false };
+		};
+		// the stack of open tags, with the stack positions of the open tags of every id,
+		// so the tree correction finds a tag or a scope without walking the stack
+		struct OpenTags
+		{
+			void Push(Tag* tag)
+			{
+				m_positions[static_cast<size_t>(tag->m_id)].push_back(m_tags.size());
+				m_open |= GetTagRules(tag->m_id).m_mask;
+				m_tags.push_back(tag);
+			}
+			// pop the tags down to size
+			void Resize(const size_t size)
+			{
+				while (m_tags.size() > size)
+				{
+					const TagId id{ m_tags.back()->m_id };
+					std::vector<size_t>& positions{ m_positions[static_cast<size_t>(id)] };
+					positions.pop_back();
+					if (positions.empty())
+						m_open &= ~GetTagRules(id).m_mask;
+					m_tags.pop_back();
+				}
+			}
+			void Clear()
+			{
+				m_tags.clear();
+				for (auto& positions : m_positions)
+					positions.clear();
+				m_open = 0;
+			}
+			Tag* Top() const { return m_tags.empty() ? nullptr : m_tags.back(); }
+			Tag* At(const size_t position) const { return m_tags[position]; }
+			size_t GetSize() const { return m_tags.size(); }
+			// the rule masks of the open tags
+			uint32_t GetOpenRules() const { return m_open; }
+			// ascending
+			const std::vector<size_t>& GetPositions(const TagId id) const { return m_positions[static_cast<size_t>(id)]; }
+			// the position above the nearest open tag of the rule mask, 0 if none of them is open
+			size_t GetScopeStart(uint32_t mask) const
+			{
+				size_t start{};
+				for (mask &= m_open; mask; mask &= mask - 1)
+					start = std::max(start, GetPositions(rule_tags[std::countr_zero(mask)]).back() + 1);
+				return start;
+			}
+
+			std::vector<Tag*> m_tags{};
+			std::array<std::vector<size_t>, tag_count> m_positions{};
+			uint32_t m_open{};
+		};
+
+	private:
+		ParseOptions m_options{};
+		std::unique_ptr<const std::string> m_buffer{};
+		std::unique_ptr<CFileMapping> m_mapping{};	// the parsed file, instead of m_buffer
+		std::vector<std::unique_ptr<const std::string>> m_retainedBuffers{};	// of the previous documents
+		std::vector<std::unique_ptr<CFileMapping>> m_retainedMappings{};
+		std::string_view m_data{};
+		std::string m_stream{};			// fed characters not parsed yet
+		std::string m_undecoded{};		// fed characters not decoded yet, the sniffed start or a cut UTF-8 sequence
+		bool m_streaming{ false };
+		bool m_streamEnded{ false };	// the fed document can't have more tags
+		bool m_sniffed{ false };		// the charset of the fed document is known
+		std::unique_ptr<CTagArena> m_arena{};
+		std::vector<Tag*> m_tags{};
+		mutable TagIndex m_tagIndex{};	// valid when it holds all the tags
+		mutable AttributeIndex m_attributeIndex{};
+		size_t m_bufferIndex{};
+		OpenTags m_openTags{};			// m_currentTag is the top
+		std::string m_decoded{};		// buffer of MakeText
+		Charset m_charset{ Charset::unknown };	// of the parsed document
+		Tag* m_currentTag{};
+
+	// multilines tags
+	private:
+		bool m_svg{ false };
+		bool m_style{ false };
+		bool m_script{ false };
+		bool m_filtered{ false };	// the content of the multiline tag makes no tag
+	};
+
+	// CSS selector compiled once and matched many times, from the right most compound selector to the left;
+	// supported: type, *, #id, .class, [attr], [attr=v], [attr~=v], [attr|=v], [attr^=v], [attr$=v], [attr*=v],
+	// the descendant, child (>), next sibling (+) and subsequent sibling (~) combinators, selector lists (,),
+	// :nth-child(an+b), :nth-last-child(an+b), :first-child, :last-child and :only-child
+	class CSelector
+	{
+	public:
+		CSelector() = default;
+		explicit CSelector(std::string_view selector)
+		{
+			Compile(selector);
+		}
+
+	public:
+		// return false, and the selector matches nothing, if the selector isn't valid
+		bool Compile(std::string_view selector)
+		{
+			m_selectors.clear();
+			m_text = selector;
+			m_index = 0;
+			while (true)
+			{
+				std::vector<Compound> compounds{};
+				if (!ParseComplex(compounds))
+				{
+					m_selectors.clear();
+					return false;
+				}
+				std::reverse(compounds.begin(), compounds.end());
+				m_selectors.push_back(std::move(compounds));
+				SkipWhiteSpaces();
+				if (m_index >= m_text.size())
+					break;
+				if (',' != m_text[m_index++])
+				{
+					m_selectors.clear();
+					return false;
+				}
+			}
+			m_text = {};
+
+			m_compounds = 0;
+			for (auto& compounds : m_selectors)
+			{
+				for (Compound& compound : compounds)
+					compound.m_column = m_compounds++;
+			}
+			return true;
+		}
+		bool IsValid() const { return !m_selectors.empty(); }
+
+		bool Match(const Tag& tag) const
+		{
+			return Match(tag, 0, nullptr);
+		}
+
+		// the matching tags in document order
+		std::vector<Tag*> Select(const std::vector<Tag*>& tags) const
+		{
+			std::vector<Tag*> found{};
+			Walk(tags, [&found](Tag* tag)
+				{
+					found.push_back(tag);
+					return true;
+				});
+			return found;
+		}
+		std::vector<Tag*> Select(const CDomTree& tree) const { return Select(tree.GetTags()); }
+		// the first matching tag in document order, nullptr if there is none
+		Tag* SelectFirst(const std::vector<Tag*>& tags) const
+		{
+			Tag* first{};
+			Walk(tags, [&first](Tag* tag)
+				{
+					first = tag;
+					return false;
+				});
+			return first;
+		}
+		Tag* SelectFirst(const CDomTree& tree) const { return SelectFirst(tree.GetTags()); }
+
+	private:
+		enum class Combinator : uint8_t
+		{
+			none = 0,	// left most compound
+			descendant,
+			child,
+			next,
+			subsequent
+		};
+
+		struct AttributeTest
+		{
+			std::string m_key{};	// lowercase
+			std::string m_value{};
+			char m_operation{};		// 0 for presence, '=', '~', '|', '^', '$', '*'
+			AttributeId m_id{ AttributeId::unknown };	// id of m_key
+		};
+
+		struct NthTest
+		{
+			int m_a{};
+			int m_b{};
+			bool m_last{ false };	// counted from the last sibling
+		};
+
+		struct Compound
+		{
+			TagId m_id{ TagId::unknown };
+			std::string m_name{};	// lowercase, empty for any tag
+			std::vector<AttributeTest> m_attributes{};
+			std::vector<NthTest> m_nth{};
+			Combinator m_combinator{ Combinator::none };	// relation to the compound on the left
+			size_t m_column{};	// among the compounds of all the selectors
+		};
+
+	private:
+		// how a tag fails a compound and the compounds on its left, so the match from the right to the left stops
+		// early: a subsequent sibling combinator stops when the siblings before fail, a descendant combinator when
+		// the parents fail
+		enum class Result : uint8_t
+		{
+			unknown = 0,	// not matched yet, in the rows of a walk
+			match,
+			fail,			// the tag only
+			fail_siblings,	// the tag and its siblings before it
+			fail_parents	// the tag and its parents
+		};
+
+		// the state of one walk: a row for each depth of the path from the top tags to the current tag, with a
+		// column for each compound of the selectors. A row is taken by the next tag at its depth, and what it
+		// knows depends only on its tag, so a row left by a finished subtree stays right. The rows keep their
+		// capacity, a walk allocates while they grow with the depth and the width of the tree, not for every tag
+		struct Rows
+		{
+			static constexpr size_t npos{ static_cast<size_t>(-1) };
+			static constexpr size_t unknown{ npos - 1 };
+
+			// the row of tag, npos if tag isn't at depth on the path of the walk
+			size_t Find(const Tag* tag, const size_t depth) const
+			{
+				return (depth < m_tags.size() && tag == m_tags[depth]) ? depth : npos;
+			}
+			// gives the row at depth to tag
+			void Enter(const Tag* tag, const size_t depth)
+			{
+				if (depth >= m_tags.size())
+				{
+					m_tags.resize(depth + 1);
+					m_results.resize((depth + 1) * m_compounds);
+					m_above.resize((depth + 1) * m_compounds);
+					m_first.resize((depth + 1) * m_compounds);
+					m_elements.resize(depth + 1);
+				}
+				m_tags[depth] = tag;
+				std::fill_n(m_results.begin() + depth * m_compounds, m_compounds, Result::unknown);
+				std::fill_n(m_above.begin() + depth * m_compounds, m_compounds, Result::unknown);
+				std::fill_n(m_first.begin() + depth * m_compounds, m_compounds, unknown);
+				m_elements[depth].clear();
+			}
+
+			size_t m_compounds{};
+			std::vector<const Tag*> m_tags{};
+			// one column for each compound
+			std::vector<Result> m_results{};	// of the tag
+			std::vector<Result> m_above{};		// match if the tag or one of its parents matches
+			std::vector<size_t> m_first{};		// the index of the first child which matches, npos if none does
+			// one for each row, the number of elements in the first childs of the tag
+			std::vector<std::vector<int>> m_elements{};
+		};
+
+		// onMatch(tag) returns false to stop the walk
+		template <typename Callback>
+		void Walk(const std::vector<Tag*>& tags, Callback&& onMatch) const
+		{
+			if (m_selectors.empty())
+				return;
+			Rows rows{};
+			rows.m_compounds = m_compounds;
+			for (Tag* top : tags)
+			{
+				rows.Enter(top, 1);
+				if (Match(*top, 1, &rows) && !onMatch(top))
+					return;
+				size_t depth{ 1 };
+				for (Tag* tag : top->Descendants())
+				{
+					// the parent of tag is on the path of the walk
+					for (++depth; tag->m_parent != rows.m_tags[depth - 1]; --depth)
+						;
+					rows.Enter(tag, depth);
+					if (Match(*tag, depth, &rows) && !onMatch(tag))
+						return;
+				}
+			}
+		}
+
+		bool Match(const Tag& tag, const size_t depth, Rows* rows) const
+		{
+			if (!IsElement(tag))
+				return false;
+			for (const auto& compounds : m_selectors)
+			{
+				if (Result::match == MatchFrom(tag, depth, compounds, 0, rows))
+					return true;
+			}
+			return false;
+		}
+
+		// tag against the compound at index and the compounds on its left, kept in the row of tag
+		Result MatchFrom(const Tag& tag, const size_t depth, const std::vector<Compound>& compounds, const size_t index, Rows* rows) const
+		{
+			const size_t row{ rows ? rows->Find(&tag, depth) : Rows::npos };
+			Result* known{ Rows::npos != row ? &rows->m_results[row * m_compounds + compounds[index].m_column] : nullptr };
+			if (known && Result::unknown != *known)
+				return *known;
+			const Result result{ MatchCombinator(tag, depth, compounds, index, rows) };
+			if (known)
+				*known = result;
+			return result;
+		}
+
+		Result MatchCombinator(const Tag& tag, const size_t depth, const std::vector<Compound>& compounds, const size_t index, Rows* rows) const
+		{
+			const Compound& compound = compounds[index];
+			if (!MatchCompound(tag, depth, compound, rows))
+				return Result::fail;
+			if (index + 1 == compounds.size())
+				return Result::match;
+
+			switch (compound.m_combinator)
+			{
+			case Combinator::child:
+			{
+				if (!tag.m_parent)
+					return Result::fail_parents;
+				// the siblings of tag have the same parent
+				const Result result{ MatchFrom(*tag.m_parent, depth - 1, compounds, index + 1, rows) };
+				return (Result::match == result || Result::fail_parents == result) ? result : Result::fail_siblings;
+			}
+			case Combinator::descendant:
+				return (tag.m_parent && MatchAbove(*tag.m_parent, depth - 1, compounds, index + 1, rows)) ? Result::match : Result::fail_parents;
+			case Combinator::next:
+			{
+				const Tag* previous = GetPreviousElement(tag);
+				return previous ? MatchFrom(*previous, depth, compounds, index + 1, rows) : Result::fail_siblings;
+			}
+			case Combinator::subsequent:
+				return MatchBefore(tag, depth, compounds, index + 1, rows) ? Result::match : Result::fail_siblings;
+			default:
+				return Result::fail;
+			}
+		}
+
+		// true if tag or one of its parents matches the compound at index and the compounds on its left; kept in
+		// the rows of tag and of its parents up to the first which is known, matches or fails all its parents,
+		// so a walk climbs a path once
+		bool MatchAbove(const Tag& tag, size_t depth, const std::vector<Compound>& compounds, const size_t index, Rows* rows) const
+		{
+			const size_t column{ compounds[index].m_column };
+			const Tag* top{ &tag };
+			size_t topDepth{ depth };
+			bool match{ false };
+			for (; top; top = top->m_parent, topDepth--)
+			{
+				if (const size_t row{ rows ? rows->Find(top, topDepth) : Rows::npos }; Rows::npos != row && Result::unknown != rows->m_above[row * m_compounds + column])
+				{
+					match = (Result::match == rows->m_above[row * m_compounds + column]);
+					break;
+				}
+				const Result result{ MatchFrom(*top, topDepth, compounds, index, rows) };
+				if (Result::match == result)
+					match = true;
+				if (Result::match == result || Result::fail_parents == result)
+					break;
+			}
+
+			if (rows)
+			{
+				for (const Tag* below = &tag; below; below = below->m_parent, depth--)
+				{
+					if (const size_t row{ rows->Find(below, depth) }; Rows::npos != row)
+						rows->m_above[row * m_compounds + column] = (match ? Result::match : Result::fail);
+					if (below == top)
+						break;
+				}
+			}
+			return match;
+		}
+
+		// true if an element before tag among its siblings matches the compound at index and the compounds on its
+		// left; the first child which matches is found once in the row of the parent
+		bool MatchBefore(const Tag& tag, const size_t depth, const std::vector<Compound>& compounds, const size_t index, Rows* rows) const
+		{
+			const size_t row{ (rows && tag.m_parent) ? rows->Find(tag.m_parent, depth - 1) : Rows::npos };
+			if (Rows::npos == row)
+			{
+				for (const Tag* previous = GetPreviousElement(tag); previous; previous = GetPreviousElement(*previous))
+				{
+					const Result result{ MatchFrom(*previous, depth, compounds, index, rows) };
+					if (Result::fail != result)
+						return Result::match == result;
+				}
+				return false;
+			}
+
+			size_t& first = rows->m_first[row * m_compounds + compounds[index].m_column];
+			if (Rows::unknown == first)
+			{
+				first = Rows::npos;
+				const auto& childs = tag.m_parent->m_childs;
+				for (size_t i = 0; i < childs.size(); ++i)
+				{
+					if (!IsElement(*childs[i]))
+						continue;
+					// a failure of the siblings is of those before, only the parents fail them all
+					const Result result{ MatchFrom(*childs[i], depth, compounds, index, rows) };
+					if (Result::match == result)
+						first = i;
+					if (Result::match == result || Result::fail_parents == result)
+						break;
+				}
+			}
+			return first < tag.GetChildIndex();
+		}
+
+		static bool MatchCompound(const Tag& tag, const size_t depth, const Compound& compound, Rows* rows)
+		{
+			if (TagId::unknown != compound.m_id)
+			{
+				if (compound.m_id != tag.m_id)
+					return false;
+			}
+			else if (!compound.m_name.empty() && !EqualsLower(tag.m_name, compound.m_name))
+			{
+				return false;
+			}
+
+			for (const auto& test : compound.m_attributes)
+			{
+				const Attribute* attr = (AttributeId::unknown != test.m_id ? tag.FindAttribute(test.m_id) : tag.FindAttribute(test.m_key));
+				if (!attr || !MatchAttribute(attr->m_value, test))
+					return false;
+			}
+
+			for (const auto& test : compound.m_nth)
+			{
+				if (!MatchNth(GetElementPosition(tag, depth, test.m_last, rows), test))
+					return false;
+			}
+			return true;
+		}
+
+		static bool MatchAttribute(std::string_view value, const AttributeTest& test)
+		{
+			switch (test.m_operation)
+			{
+			case 0:
+				return true;
+			case '=':
+				return value == test.m_value;
+			case '~':	// one of the white space separated words
+				for (size_t start = value.find_first_not_of(whitespace); std::string_view::npos != start;)
+				{
+					const size_t end = std::min(value.find_first_of(whitespace, start), value.size());
+					if (value.substr(start, end - start) == test.m_value)
+						return true;
+					start = value.find_first_not_of(whitespace, end);
+				}
+				return false;
+			case '|':
+				return value == test.m_value ||
+					(value.size() > test.m_value.size() && value.starts_with(test.m_value) && '-' == value[test.m_value.size()]);
+			case '^':
+				return !test.m_value.empty() && value.starts_with(test.m_value);
+			case '$':
+				return !test.m_value.empty() && value.ends_with(test.m_value);
+			case '*':
+				return !test.m_value.empty() && std::string_view::npos != value.find(test.m_value);
+			default:
+				return false;
+			}
+		}
+
+		// true if position = a * n + b for some n >= 0
+		static bool MatchNth(const int position, const NthTest& test)
+		{
+			if (0 == test.m_a)
+				return position == test.m_b;
+			const int steps = position - test.m_b;
+			return 0 == steps % test.m_a && 0 <= steps / test.m_a;
+		}
+
+		// 1 based position among the element siblings, a top tag is the only child
+		static int GetElementPosition(const Tag& tag, const size_t depth, const bool fromLast, Rows* rows)
+		{
+			if (!tag.m_parent)
+				return 1;
+			const auto& childs = tag.m_parent->m_childs;
+			const size_t index{ tag.GetChildIndex() };
+			if (index >= childs.size())
+				return 1;
+			const size_t row{ rows ? rows->Find(tag.m_parent, depth - 1) : Rows::npos };
+			if (Rows::npos == row)
+			{
+				const auto first = childs.begin() + (fromLast ? index + 1 : 0);
+				const auto last = fromLast ? childs.end() : childs.begin() + index;
+				return 1 + static_cast<int>(std::count_if(first, last, [](const Tag* child) { return IsElement(*child); }));
+			}
+
+			// elements[i] is the number of elements in the first i childs, counted once in the row of the parent
+			std::vector<int>& elements = rows->m_elements[row];
+			if (elements.empty())
+			{
+				elements.push_back(0);
+				for (const Tag* child : childs)
+					elements.push_back(elements.back() + IsElement(*child));
+			}
+			return 1 + (fromLast ? elements.back() - elements[index + 1] : elements[index]);
+		}
+
+		static const Tag* GetPreviousElement(const Tag& tag)
+		{
+			if (!tag.m_parent)
+				return nullptr;
+			const auto& childs = tag.m_parent->m_childs;
+			for (size_t index = tag.GetChildIndex(); index-- > 0;)
+			{
+				if (IsElement(*childs[index]))
+					return childs[index];
+			}
+			return nullptr;
+		}
+
+		// selector parsing, m_text is the selector being compiled
+		bool ParseComplex(std::vector<Compound>& compounds)
+		{
+			SkipWhiteSpaces();
+			Combinator combinator{ Combinator::none };
+			while (true)
+			{
+				Compound compound{};
+				if (!ParseCompound(compound))
+					return false;
+				compound.m_combinator = combinator;
+				compounds.push_back(std::move(compound));
+
+				const size_t start{ m_index };
+				SkipWhiteSpaces();
+				if (m_index >= m_text.size() || ',' == m_text[m_index])
+					break;
+				switch (m_text[m_index])
+				{
+				case '>':
+					combinator = Combinator::child;
+					break;
+				case '+':
+					combinator = Combinator::next;
+					break;
+				case '~':
+					combinator = Combinator::subsequent;
+					break;
+				default:
+					if (start == m_index)
+						return false;
+					combinator = Combinator::descendant;
+					continue;
+				}
+				m_index++;
+				SkipWhiteSpaces();
+			}
+			return true;
+		}
+
+		bool ParseCompound(Compound& compound)
+		{
+			bool empty{ true };
+			if (m_index < m_text.size() && '*' == m_text[m_index])
+			{
+				m_index++;
+				empty = false;
+			}
+			else if (const std::string_view name = ParseName(); !name.empty())
+			{
+				compound.m_name = Lower(name);
+				compound.m_id = GetTagId(name);
+				empty = false;
+			}
+
+			while (m_index < m_text.size())
+			{
+				const char c{ m_text[m_index] };
+				if ('#' == c || '.' == c)
+				{
+					m_index++;
+					const std::string_view name = ParseName();
+					if (name.empty())
+						return false;
+					compound.m_attributes.push_back({ '#' == c ? "id" : "class", std::string(name), '#' == c ? '=' : '~', '#' == c ? AttributeId::id : AttributeId::class_ });
+				}
+				else if ('[' == c)
+				{
+					m_index++;
+					if (!ParseAttribute(compound))
+						return false;
+				}
+				else if (':' == c)
+				{
+					m_index++;
+					if (!ParsePseudoClass(compound))
+						return false;
+				}
+				else
+				{
+					break;
+				}
+				empty = false;
+			}
+			return !empty;
+		}
+
+		bool ParseAttribute(Compound& compound)
+		{
+			SkipWhiteSpaces();
+			AttributeTest test{ Lower(ParseName()) };
+			if (test.m_key.empty())
+				return false;
+			SkipWhiteSpaces();
+			if (m_index >= m_text.size())
+				return false;
+
+			const char c{ m_text[m_index] };
+			if ('=' == c)
+			{
+				test.m_operation = '=';
+				m_index++;
+			}
+			else if (std::string_view("~|^$*").find(c) != std::string_view::npos && m_index + 1 < m_text.size() && '=' == m_text[m_index + 1])
+			{
+				test.m_operation = c;
+				m_index += 2;
+			}
+			if (test.m_operation)
+			{
+				SkipWhiteSpaces();
+				if (m_index < m_text.size() && ('\"' == m_text[m_index] || '\'' == m_text[m_index]))
+				{
+					const char quote{ m_text[m_index++] };
+					const size_t end{ m_text.find(quote, m_index) };
+					if (std::string_view::npos == end)
+						return false;
+					test.m_value = m_text.substr(m_index, end - m_index);
+					m_index = end + 1;
+				}
+				else
+				{
+					test.m_value = ParseName();
+					if (test.m_value.empty())
+						return false;
+				}
+				SkipWhiteSpaces();
+			}
+			if (m_index >= m_text.size() || ']' != m_text[m_index++])
+				return false;
+			test.m_id = GetAttributeId(test.m_key);
+			compound.m_attributes.push_back(std::move(test));
+			return true;
+		}
+
+		bool ParsePseudoClass(Compound& compound)
+		{
+			const std::string name{ Lower(ParseName()) };
+			if ("first-child" == name || "last-child" == name)
+			{
+				compound.m_nth.push_back({ 0, 1, "last-child" == name });
+				return true;
+			}
+			if ("only-child" == name)
+			{
+				compound.m_nth.push_back({ 0, 1, false });
+				compound.m_nth.push_back({ 0, 1, true });
+				return true;
+			}
+			if (("nth-child" != name && "nth-last-child" != name) || m_index >= m_text.size() || '(' != m_text[m_index])
+				return false;
+
+			const size_t end{ m_text.find(')', m_index) };
+			if (std::string_view::npos == end)
+				return false;
+			NthTest test{};
+			test.m_last = ("nth-last-child" == name);
+			if (!ParseNth(m_text.substr(m_index + 1, end - m_index - 1), test))
+				return false;
+			m_index = end + 1;
+			compound.m_nth.push_back(test);
+			return true;
+		}
+
+		// an+b, odd, even
+		static bool ParseNth(std::string_view text, NthTest& test)
+		{
+			std::string expression{};
+			for (const char c : text)
+			{
+				if (std::string_view::npos == whitespace.find(c))
+					expression += ToLower(c);
+			}
+			if ("odd" == expression)
+			{
+				test.m_a = 2;
+				test.m_b = 1;
+				return true;
+			}
+			if ("even" == expression)
+			{
+				test.m_a = 2;
+				test.m_b = 0;
+				return true;
+			}
+
+			std::string_view rest{ expression };
+			const auto number = [&rest](int& value)
+			{
+				const bool negative{ !rest.empty() && '-' == rest.front() };
+				if (!rest.empty() && ('-' == rest.front() || '+' == rest.front()))
+					rest.remove_prefix(1);
+				size_t digits{};
+				value = 0;
+				for (; digits < rest.size() && '0' <= rest[digits] && '9' >= rest[digits]; ++digits)
+					value = value * 10 + (rest[digits] - '0');
+				rest.remove_prefix(digits);
+				if (negative)
+					value = -value;
+				return digits;
+			};
+
+			const size_t n{ rest.find('n') };
+			if (std::string_view::npos == n)
+				return number(test.m_b) && rest.empty();
+
+			std::string_view a{ rest.substr(0, n) };
+			if (a.empty() || "+" == a)
+				test.m_a = 1;
+			else if ("-" == a)
+				test.m_a = -1;
+			else if (rest = a; !number(test.m_a) || !rest.empty())
+				return false;
+			rest = std::string_view(expression).substr(n + 1);
+			test.m_b = 0;
+			if (rest.empty())
+				return true;
+			if ('+' != rest.front() && '-' != rest.front())
+				return false;
+			return number(test.m_b) && rest.empty();
+		}
+
+		std::string_view ParseName()
+		{
+			const size_t start{ m_index };
+			while (m_index < m_text.size())
+			{
+				const unsigned char c = static_cast<unsigned char>(m_text[m_index]);
+				if (!(std::isalnum(c) || '-' == c || '_' == c || c >= 0x80))
+					break;
+				m_index++;
+			}
+			return m_text.substr(start, m_index - start);
+		}
+
+		void SkipWhiteSpaces()
+		{
+			m_index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_text, m_index);
+		}
+
+		static std::string Lower(std::string_view text)
+		{
+			std::string lower(text);
+			std::transform(lower.begin(), lower.end(), lower.begin(), ToLower);
+			return lower;
+		}
+
+	private:
+		std::vector<std::vector<Compound>> m_selectors{};	// the compounds of every selector of the list, right to left
+		size_t m_compounds{};								// in all the selectors, the columns of a walk
+		std::string_view m_text{};							// while compiling
+		size_t m_index{};
+	};
+
+	// XPath 1.0 subset compiled once into steps, a tag is matched from the last step to the first one,
+	// so no node set is built between the steps;
+	// supported: the child, descendant, descendant-or-self, self, parent and following-sibling axes, the //, . and ..
+	// abbreviations, the name, *, text(), comment() and node() tests, unions (|) and the predicates [n], [last()],
+	// [last() - n], position() compared to n or last() - n, @attr, @attr = 'v', @attr != 'v', text(), text() = 'v',
+	// text() != 'v', contains(@attr or text(), 'v'), starts-with(@attr or text(), 'v') and not(), joined with and / or
+	class CXPath
+	{
+	public:
+		CXPath() = default;
+		explicit CXPath(std::string_view path)
+		{
+			Compile(path);
+		}
+
+	public:
+		// return false, and the path matches nothing, if the path isn't valid
+		bool Compile(std::string_view path)
+		{
+			m_paths.clear();
+			m_text = path;
+			m_index = 0;
+			while (true)
+			{
+				Path compiled{};
+				if (!ParsePath(compiled))
+				{
+					m_paths.clear();
+					m_text = {};
+					return false;
+				}
+				m_paths.push_back(std::move(compiled));
+				SkipWhiteSpaces();
+				if (m_index >= m_text.size())
+					break;
+				if ('|' != m_text[m_index++])
+				{
+					m_paths.clear();
+					m_text = {};
+					return false;
+				}
+			}
+			m_text = {};
+
+			// the columns of a walk
+			m_steps = 0;
+			m_predicates = 0;
+			for (Path& compiled : m_paths)
+			{
+				for (Step& step : compiled.m_steps)
+				{
+					step.m_column = m_steps++;
+					for (Predicate& predicate : step.m_predicates)
+						predicate.m_column = m_predicates++;
+				}
+			}
+			return true;
+		}
+		bool IsValid() const { return !m_paths.empty(); }
+
+		// the matching tags in document order; root is the only tag of the document,
+		// relative paths start at root and the parent axis doesn't leave root
+		std::vector<Tag*> Select(Tag& root) const
+		{
+			Tag* top{ &root };
+			return Select(Scope{ { &top, 1 }, &root, &root });
+		}
+		// the tags are the top tags of the document, relative paths start at the document
+		std::vector<Tag*> Select(const std::vector<Tag*>& tags) const { return Select(Scope{ tags }); }
+		std::vector<Tag*> Select(const CDomTree& tree) const { return Select(tree.GetTags()); }
+		// the first matching tag in document order, nullptr if there is none
+		Tag* SelectFirst(Tag& root) const
+		{
+			Tag* top{ &root };
+			return SelectFirst(Scope{ { &top, 1 }, &root, &root });
+		}
+		Tag* SelectFirst(const std::vector<Tag*>& tags) const { return SelectFirst(Scope{ tags }); }
+		Tag* SelectFirst(const CDomTree& tree) const { return SelectFirst(tree.GetTags()); }
+
+	private:
+		// same order as axis_names
+		enum class Axis : uint8_t
+		{
+			child = 0,
+			descendant,
+			descendant_or_self,
+			self,
+			parent,
+			following_sibling
+		};
+		static constexpr std::array<std::string_view, 6> axis_names
+		{
+			"child", "descendant", "descendant-or-self", "self", "parent", "following-sibling"
+		};
+
+		enum class NodeTest : uint8_t
+		{
+			name = 0,
+			element,	// *
+			text,
+			comment,
+			node
+		};
+
+		enum class Function : uint8_t
+		{
+			position = 0,	// position() compared to m_number, or to last() - m_number if m_fromLast
+			attribute,		// @m_key, compared to m_value if m_operator isn't none
+			text,			// any text child, compared to m_value if m_operator isn't none
+			contains,		// contains(@m_key, m_value), text() if m_key is empty
+			starts_with
+		};
+
+		enum class Operator : uint8_t
+		{
+			none = 0,
+			equal,
+			not_equal,
+			less,
+			less_equal,
+			greater,
+			greater_equal
+		};
+
+		struct Term
+		{
+			Function m_function{ Function::position };
+			Operator m_operator{ Operator::none };
+			std::string m_key{};	// lowercase
+			std::string m_value{};
+			int m_number{};
+			bool m_fromLast{ false };
+			bool m_negate{ false };	// not()
+		};
+
+		// the terms of a group are joined with and, the groups with or
+		struct Predicate
+		{
+			std::vector<std::vector<Term>> m_groups{};
+			bool m_position{ false };	// a term needs position()
+			bool m_size{ false };		// a term needs last()
+			size_t m_column{};			// among the predicates of all the steps
+		};
+
+		struct Step
+		{
+			Axis m_axis{ Axis::child };
+			NodeTest m_test{ NodeTest::node };
+			TagId m_id{ TagId::unknown };
+			std::string m_name{};	// lowercase
+			std::vector<Predicate> m_predicates{};
+			size_t m_column{};			// among the steps of all the paths
+		};
+
+		struct Path
+		{
+			std::vector<Step> m_steps{};
+			bool m_absolute{ false };
+		};
+
+		// the tags seen by one evaluation, a null tag is the document, parent of the top tags
+		struct Scope
+		{
+			std::span<Tag* const> m_top{};
+			const Tag* m_root{};	// the only top tag when a subtree is evaluated
+			const Tag* m_context{};	// where the relative paths start
+		};
+
+		// what a walk knows of a tag
+		enum class Known : uint8_t
+		{
+			unknown = 0,
+			yes,
+			no
+		};
+
+		// the state of one walk: a row for each depth of the path from the document to the current tag, with a
+		// column for each step or predicate of the paths. A row is taken by the next tag at its depth, and what it
+		// knows depends only on its tag, so a row left by a finished subtree stays right. The rows and the lists
+		// in them keep their capacity, a walk allocates while they grow with the depth and the width of the tree,
+		// not for every step or tag
+		struct Rows
+		{
+			static constexpr size_t npos{ static_cast<size_t>(-1) };
+			static constexpr size_t unknown{ npos - 1 };
+
+			// the row of tag, npos if tag isn't at depth on the path of the walk
+			size_t Find(const Tag* tag, const size_t depth) const
+			{
+				return (depth < m_tags.size() && tag == m_tags[depth]) ? depth : npos;
+			}
+
+			size_t m_steps{};
+			size_t m_predicates{};
+			std::vector<const Tag*> m_tags{};
+			// one column for each step
+			std::vector<Known> m_matches{};		// the tag is selected by the step
+			std::vector<size_t> m_above{};		// the depth of the nearest of the tag and its parents selected by the step before
+			std::vector<Known> m_listed{};		// m_contexts is filled
+			std::vector<std::vector<size_t>> m_contexts{};	// the childs selected by the step before a following-sibling step
+			// one column for each predicate, the nodes which pass the node test of its step and the predicates before it
+			std::vector<std::vector<int>> m_counts{};	// the childs up to each child, from a zero for no child
+			std::vector<int> m_before{};		// the nodes before the tag in document order
+			std::vector<int> m_through{};		// the same with the tag
+			std::vector<int> m_sizes{};			// the nodes of the descendant axis of the tag, -1 until they are counted
+			std::vector<int> m_passed{};		// the nodes seen so far, a single row
+		};
+
+	private:
+		std::vector<Tag*> Select(const Scope& scope) const
+		{
+			std::vector<Tag*> found{};
+			Walk(scope, [&found](Tag* tag)
+				{
+					found.push_back(tag);
+					return true;
+				});
+			return found;
+		}
+		Tag* SelectFirst(const Scope& scope) const
+		{
+			Tag* first{};
+			Walk(scope, [&first](Tag* tag)
+				{
+					first = tag;
+					return false;
+				});
+			return first;
+		}
+
+		// onMatch(tag) returns false to stop the walk
+		template <typename Callback>
+		void Walk(const Scope& scope, Callback&& onMatch) const
+		{
+			if (m_paths.empty())
+				return;
+			Rows rows{};
+			rows.m_steps = m_steps;
+			rows.m_predicates = m_predicates;
+			rows.m_passed.assign(m_predicates, 0);
+			Enter(scope, nullptr, 0, rows);
+			for (Tag* top : scope.m_top)
+			{
+				Enter(scope, top, 1, rows);
+				if (Match(scope, top, 1, rows) && !onMatch(top))
+					return;
+				size_t depth{ 1 };
+				for (Tag* tag : top->Descendants())
+				{
+					// the parent of tag is on the path of the walk
+					for (++depth; tag->m_parent != rows.m_tags[depth - 1]; --depth)
+						;
+					Enter(scope, tag, depth, rows);
+					if (Match(scope, tag, depth, rows) && !onMatch(tag))
+						return;
+				}
+			}
+		}
+
+		// gives the row at depth to tag, and counts tag for the positional predicates of the descendant axes
+		void Enter(const Scope& scope, const Tag* tag, const size_t depth, Rows& rows) const
+		{
+			if (depth >= rows.m_tags.size())
+			{
+				rows.m_tags.resize(depth + 1);
+				rows.m_matches.resize((depth + 1) * m_steps);
+				rows.m_above.resize((depth + 1) * m_steps);
+				rows.m_listed.resize((depth + 1) * m_steps);
+				rows.m_contexts.resize((depth + 1) * m_steps);
+				rows.m_counts.resize((depth + 1) * m_predicates);
+				rows.m_before.resize((depth + 1) * m_predicates);
+				rows.m_through.resize((depth + 1) * m_predicates);
+				rows.m_sizes.resize((depth + 1) * m_predicates);
+			}
+			rows.m_tags[depth] = tag;
+			std::fill_n(rows.m_matches.begin() + depth * m_steps, m_steps, Known::unknown);
+			std::fill_n(rows.m_above.begin() + depth * m_steps, m_steps, Rows::unknown);
+			std::fill_n(rows.m_listed.begin() + depth * m_steps, m_steps, Known::unknown);
+			std::fill_n(rows.m_sizes.begin() + depth * m_predicates, m_predicates, -1);
+			for (size_t i = 0; i < m_predicates; ++i)
+				rows.m_counts[depth * m_predicates + i].clear();
+
+			for (const Path& path : m_paths)
+			{
+				for (const Step& step : path.m_steps)
+				{
+					if (Axis::descendant != step.m_axis && Axis::descendant_or_self != step.m_axis)
+						continue;
+					// the first predicate which needs position() or last(), the nodes before it don't depend on the context
+					const auto first = std::find_if(step.m_predicates.begin(), step.m_predicates.end(), [](const Predicate& predicate)
+						{
+							return predicate.m_position || predicate.m_size;
+						});
+					if (step.m_predicates.end() == first)
+						continue;
+					const size_t cell{ depth * m_predicates + first->m_column };
+					int& passed = rows.m_passed[first->m_column];
+					rows.m_before[cell] = passed;
+					if (MatchNodeTest(tag, step) && MatchPredicates(scope, tag, depth, nullptr, 0, step, first - step.m_predicates.begin(), rows))
+						passed++;
+					rows.m_through[cell] = passed;
+				}
+			}
+		}
+
+		bool Match(const Scope& scope, const Tag* tag, const size_t depth, Rows& rows) const
+		{
+			for (const auto& path : m_paths)
+			{
+				if (MatchStep(scope, tag, depth, path, path.m_steps.size() - 1, rows))
+					return true;
+			}
+			return false;
+		}
+
+		// true if node, at depth below the document, is selected by the step at index from a context node selected
+		// by the steps before it; kept in the row of node
+		bool MatchStep(const Scope& scope, const Tag* node, const size_t depth, const Path& path, const size_t index, Rows& rows) const
+		{
+			const Step& step = path.m_steps[index];
+			const size_t row{ rows.Find(node, depth) };
+			Known* known{ Rows::npos != row ? &rows.m_matches[row * m_steps + step.m_column] : nullptr };
+			if (known && Known::unknown != *known)
+				return Known::yes == *known;
+			const bool match{ MatchNodeTest(node, step) && MatchAxis(scope, node, depth, path, index, rows) };
+			if (known)
+				*known = (match ? Known::yes : Known::no);
+			return match;
+		}
+
+		// true if the predicates of the step at index hold for node from a context node of its axis selected by the steps before
+		bool MatchAxis(const Scope& scope, const Tag* node, const size_t depth, const Path& path, const size_t index, Rows& rows) const
+		{
+			const Step& step = path.m_steps[index];
+			const size_t count{ step.m_predicates.size() };
+			const auto matchContext = [&](const Tag* context, const size_t contextDepth)
+			{
+				return MatchPrevious(scope, context, contextDepth, path, index, rows) &&
+					MatchPredicates(scope, node, depth, context, contextDepth, step, count, rows);
+			};
+
+			switch (step.m_axis)
+			{
+			case Axis::child:
+				return node && matchContext(GetParent(scope, node), depth - 1);
+			case Axis::descendant_or_self:
+			case Axis::descendant:
+			{
+				const Tag* context{ node };
+				size_t contextDepth{ depth };
+				if (Axis::descendant == step.m_axis)
+				{
+					if (!node)
+						return false;
+					context = GetParent(scope, node);
+					contextDepth--;
+				}
+				if (!NeedsPosition(step, count))
+				{
+					// the predicates don't depend on the context, any context selected by the step before will do
+					return MatchPredicates(scope, node, depth, nullptr, 0, step, count, rows) &&
+						Rows::npos != FindAbove(scope, context, contextDepth, path, index, rows);
+				}
+				// from the nearest context selected by the step before to the next one above it
+				while (true)
+				{
+					const size_t found{ FindAbove(scope, context, contextDepth, path, index, rows) };
+					if (Rows::npos == found)
+						return false;
+					if (Rows::npos != rows.Find(context, contextDepth))
+					{
+						// the parents of a tag on the path of the walk are the tags of the rows above
+						context = rows.m_tags[found];
+						contextDepth = found;
+					}
+					for (; contextDepth > found; contextDepth--)
+						context = GetParent(scope, context);
+					if (MatchPredicates(scope, node, depth, context, contextDepth, step, count, rows))
+						return true;
+					if (!context)
+						return false;
+					context = GetParent(scope, context);
+					contextDepth--;
+				}
+			}
+			case Axis::self:
+				return matchContext(node, depth);
+			case Axis::parent:
+				for (const Tag* context : GetChilds(scope, node))
+				{
+					if (matchContext(context, depth + 1))
+						return true;
+				}
+				return false;
+			case Axis::following_sibling:
+			{
+				if (!node)
+					return false;
+				const Tag* parent{ GetParent(scope, node) };
+				const auto siblings = GetChilds(scope, parent);
+				const size_t nodeIndex{ GetSiblingIndex(siblings, node) };
+				const size_t row{ rows.Find(parent, depth - 1) };
+				if (Rows::npos == row)
+				{
+					for (size_t i = 0; i < nodeIndex; ++i)
+					{
+						if (matchContext(siblings[i], depth))
+							return true;
+					}
+					return false;
+				}
+
+				// the childs of parent selected by the step before, listed once in the row of parent
+				const size_t cell{ row * m_steps + step.m_column };
+				std::vector<size_t>& contexts = rows.m_contexts[cell];
+				if (Known::unknown == rows.m_listed[cell])
+				{
+					contexts.clear();
+					for (size_t i = 0; i < siblings.size(); ++i)
+					{
+						if (MatchPrevious(scope, siblings[i], depth, path, index, rows))
+							contexts.push_back(i);
+					}
+					rows.m_listed[cell] = Known::yes;
+				}
+				if (!NeedsPosition(step, count))
+				{
+					// the predicates don't depend on the context, any context before node will do
+					return !contexts.empty() && contexts.front() < nodeIndex &&
+						MatchPredicates(scope, node, depth, nullptr, 0, step, count, rows);
+				}
+				// from the nearest context, where a small position is found first
+				for (auto context = std::lower_bound(contexts.begin(), contexts.end(), nodeIndex); contexts.begin() != context;)
+				{
+					if (MatchPredicates(scope, node, depth, siblings[*--context], depth, step, count, rows))
+						return true;
+				}
+				return false;
+			}
+			default:
+				return false;
+			}
+		}
+
+		// true if context is selected by the steps before index
+		bool MatchPrevious(const Scope& scope, const Tag* context, const size_t depth, const Path& path, const size_t index, Rows& rows) const
+		{
+			if (0 == index)
+				return context == (path.m_absolute ? nullptr : scope.m_context);
+			return MatchStep(scope, context, depth, path, index - 1, rows);
+		}
+
+		// the depth of the nearest of tag and its parents selected by the steps before index, Rows::npos if there is
+		// none; kept in the rows of tag and of its parents up to the first which is known or selected, so a walk
+		// climbs a path once
+		size_t FindAbove(const Scope& scope, const Tag* tag, size_t depth, const Path& path, const size_t index, Rows& rows) const
+		{
+			const size_t column{ path.m_steps[index].m_column };
+			const Tag* top{ tag };
+			size_t topDepth{ depth };
+			size_t found{ Rows::npos };
+			while (true)
+			{
+				if (const size_t row{ rows.Find(top, topDepth) }; Rows::npos != row && Rows::unknown != rows.m_above[row * m_steps + column])
+				{
+					found = rows.m_above[row * m_steps + column];
+					break;
+				}
+				if (MatchPrevious(scope, top, topDepth, path, index, rows))
+				{
+					found = topDepth;
+					break;
+				}
+				if (!top)
+					break;
+				top = GetParent(scope, top);
+				topDepth--;
+			}
+
+			for (const Tag* below = tag;; below = GetParent(scope, below), depth--)
+			{
+				if (const size_t row{ rows.Find(below, depth) }; Rows::npos != row)
+					rows.m_above[row * m_steps + column] = found;
+				if (below == top)
+					break;
+			}
+			return found;
+		}
+
+		// true if one of the first count predicates of the step needs position() or last()
+		static bool NeedsPosition(const Step& step, const size_t count)
+		{
+			return std::any_of(step.m_predicates.begin(), step.m_predicates.begin() + count, [](const Predicate& predicate)
+				{
+					return predicate.m_position || predicate.m_size;
+				});
+		}
+
+		// the first count predicates of the step, position() and last() count the nodes of the axis of context
+		// which pass the node test and the predicates before
+		bool MatchPredicates(const Scope& scope, const Tag* node, const size_t depth, const Tag* context, const size_t contextDepth,
+			const Step& step, const size_t count, Rows& rows) const
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				const Predicate& predicate = step.m_predicates[i];
+				int position{};
+				int size{};
+				if ((predicate.m_position || predicate.m_size) &&
+					!CountPosition(scope, node, depth, context, contextDepth, step, i, rows, position, size))
+				{
+					ForEachInAxis(scope, context, step.m_axis, [&](const Tag* tag)
+						{
+							if (!MatchNodeTest(tag, step) || !MatchPredicates(scope, tag, Rows::npos, context, contextDepth, step, i, rows))
+								return true;
+							size++;
+							if (tag == node)
+								position = size;
+							return !position || predicate.m_size;
+						});
+				}
+
+				const bool match = std::any_of(predicate.m_groups.begin(), predicate.m_groups.end(), [&](const std::vector<Term>& group)
+					{
+						return std::all_of(group.begin(), group.end(), [&](const Term& term)
+							{
+								return MatchTerm(node, term, position, size);
+							});
+					});
+				if (!match)
+					return false;
+			}
+			return true;
+		}
+
+		// position() and last() of node for the predicate at index from the counts in the rows, false if the axis
+		// has to be walked: a node off the path of the walk, predicates before which depend on the context
+		bool CountPosition(const Scope& scope, const Tag* node, const size_t depth, const Tag* context, const size_t contextDepth,
+			const Step& step, const size_t index, Rows& rows, int& position, int& size) const
+		{
+			switch (step.m_axis)
+			{
+			case Axis::child:
+			{
+				const std::vector<int>* counts{ GetCounts(scope, context, contextDepth, step, index, rows) };
+				if (!counts)
+					return false;
+				position = (*counts)[GetSiblingIndex(GetChilds(scope, context), node) + 1];
+				size = counts->back();
+				return true;
+			}
+			case Axis::following_sibling:
+			{
+				if (!context || NeedsPosition(step, index))
+					return false;
+				// all the childs of the parent are counted once
+				const Tag* parent{ GetParent(scope, context) };
+				const std::vector<int>* counts{ GetCounts(scope, parent, contextDepth - 1, step, index, rows) };
+				if (!counts)
+					return false;
+				const auto siblings = GetChilds(scope, parent);
+				const int before{ (*counts)[GetSiblingIndex(siblings, context) + 1] };
+				position = (*counts)[GetSiblingIndex(siblings, node) + 1] - before;
+				size = counts->back() - before;
+				return true;
+			}
+			case Axis::descendant:
+			case Axis::descendant_or_self:
+			{
+				// the nodes passed by the walk from context to node, which is below context in document order
+				const size_t nodeRow{ rows.Find(node, depth) };
+				const size_t contextRow{ rows.Find(context, contextDepth) };
+				if (NeedsPosition(step, index) || Rows::npos == nodeRow || Rows::npos == contextRow)
+					return false;
+				const size_t column{ step.m_predicates[index].m_column };
+				const size_t contextCell{ contextRow * m_predicates + column };
+				const int before{ Axis::descendant_or_self == step.m_axis ? rows.m_before[contextCell] : rows.m_through[contextCell] };
+				position = rows.m_through[nodeRow * m_predicates + column] - before;
+				int& counted = rows.m_sizes[contextCell];
+				if (step.m_predicates[index].m_size && counted < 0)
+				{
+					counted = 0;
+					ForEachInAxis(scope, context, step.m_axis, [&](const Tag* tag)
+						{
+							if (MatchNodeTest(tag, step) && MatchPredicates(scope, tag, Rows::npos, context, contextDepth, step, index, rows))
+								counted++;
+							return true;
+						});
+				}
+				size = counted;
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+		// the childs of parent up to each child which pass the node test and the predicates before index, counted
+		// once in the row of parent; nullptr if parent isn't at depth on the path of the walk
+		const std::vector<int>* GetCounts(const Scope& scope, const Tag* parent, const size_t depth, const Step& step, const size_t index, Rows& rows) const
 		{
-			if (m_bufferIndex >= m_data.length())
-				return false;
-
-			if (!m_currentTag || !m_script || !m_style || !m_svg)
-				SkipWhiteSpaces();
-
-			if (m_svg)
-				return ParseValue();
+			const size_t row{ rows.Find(parent, depth) };
+			if (Rows::npos == row)
+				return nullptr;
+			std::vector<int>& counts = rows.m_counts[row * m_predicates + step.m_predicates[index].m_column];
+			if (counts.empty())
+			{
+				counts.push_back(0);
+				for (const Tag* child : GetChilds(scope, parent))
+				{
+					const bool pass{ MatchNodeTest(child, step) && MatchPredicates(scope, child, depth + 1, parent, depth, step, index, rows) };
+					counts.push_back(counts.back() + (pass ? 1 : 0));
+				}
+			}
+			return &counts;
+		}
 
-			if ('<' == m_data[m_bufferIndex])
-				return ParseTag();
-			else
-				return ParseValue();
+		static bool MatchTerm(const Tag* node, const Term& term, const int position, const int size)
+		{
+			bool match{ false };
+			switch (term.m_function)
+			{
+			case Function::position:
+				match = Compare(position, term.m_fromLast ? size - term.m_number : term.m_number, term.m_operator);
+				break;
+			case Function::attribute:
+				if (const Attribute* attr = node ? node->FindAttribute(term.m_key) : nullptr)
+					match = Operator::none == term.m_operator || CompareText(attr->m_value, term.m_value, term.m_operator);
+				break;
+			case Function::text:
+				if (node)
+				{
+					match = std::any_of(node->m_childs.begin(), node->m_childs.end(), [&term](const Tag* tag)
+						{
+							return tag->m_name.empty() &&
+								(Operator::none == term.m_operator || CompareText(Trim(tag->m_value), term.m_value, term.m_operator));
+						});
+				}
+				break;
+			case Function::contains:
+			case Function::starts_with:
+			{
+				std::string_view value{};
+				if (term.m_key.empty())
+					value = GetText(node);
+				else if (const Attribute* attr = node ? node->FindAttribute(term.m_key) : nullptr)
+					value = attr->m_value;
+				match = (Function::contains == term.m_function ? std::string_view::npos != value.find(term.m_value) : value.starts_with(term.m_value));
+				break;
+			}
+			default:
+				break;
+			}
+			return match != term.m_negate;
 		}
 
-		bool ParseTag()
+		static bool Compare(const int lhs, const int rhs, const Operator op)
 		{
-			if (m_bufferIndex >= m_data.length())
+			switch (op)
+			{
+			case Operator::equal:
+				return lhs == rhs;
+			case Operator::not_equal:
+				return lhs != rhs;
+			case Operator::less:
+				return lhs < rhs;
+			case Operator::less_equal:
+				return lhs <= rhs;
+			case Operator::greater:
+				return lhs > rhs;
+			case Operator::greater_equal:
+				return lhs >= rhs;
+			default:
 				return false;
+			}
+		}
 
-			m_bufferIndex++;
+		static bool CompareText(std::string_view lhs, std::string_view rhs, const Operator op)
+		{
+			return (lhs == rhs) == (Operator::equal == op);
+		}
 
-			if (m_bufferIndex >= m_data.length())
-				return false;
+		static bool MatchNodeTest(const Tag* tag, const Step& step)
+		{
+			if (!tag)
+				return NodeTest::node == step.m_test;
+			switch (step.m_test)
+			{
+			case NodeTest::name:
+				if (TagId::unknown != step.m_id)
+					return step.m_id == tag->m_id;
+				return IsElement(*tag) && EqualsLower(tag->m_name, step.m_name);
+			case NodeTest::element:
+				return IsElement(*tag);
+			case NodeTest::text:
+				return tag->m_name.empty();
+			case NodeTest::comment:
+				return tag->m_name.view().starts_with("!--");
+			default:
+				return true;
+			}
+		}
 
-			switch (m_data[m_bufferIndex])
+		// onNode(tag) returns false to stop, the nodes come in document order
+		template <typename Callback>
+		static void ForEachInAxis(const Scope& scope, const Tag* context, const Axis axis, Callback&& onNode)
+		{
+			switch (axis)
 			{
-			case '/':
-				m_bufferIndex++;
-				ParseClosingTag();
+			case Axis::child:
+				for (const Tag* tag : GetChilds(scope, context))
+				{
+					if (!onNode(tag))
+						return;
+				}
 				break;
-			case '!':
-			case '?':
-				if ('!' == m_data[m_bufferIndex]
-					&& m_bufferIndex < m_data.length() - 3
-					&& '-' == m_data[m_bufferIndex + 1]
-					&& '-' == m_data[m_bufferIndex + 2])
-					ParseCommentTag();
-				else
-					ParseSpecialTag();
+			case Axis::descendant_or_self:
+				if (!onNode(context))
+					return;
+				[[fallthrough]];
+			case Axis::descendant:
+				for (const Tag* tag = GetNext(scope, context, context); tag; tag = GetNext(scope, tag, context))
+				{
+					if (!onNode(tag))
+						return;
+				}
+				break;
+			case Axis::self:
+				onNode(context);
+				break;
+			case Axis::parent:
+				if (context)
+					onNode(GetParent(scope, context));
+				break;
+			case Axis::following_sibling:
+				if (context)
+				{
+					const auto siblings = GetChilds(scope, GetParent(scope, context));
+					for (size_t index = GetSiblingIndex(siblings, context) + 1; index < siblings.size(); ++index)
+					{
+						if (!onNode(siblings[index]))
+							return;
+					}
+				}
 				break;
 			default:
-				if (!ParseOpeningTag())
+				break;
+			}
+		}
+
+		static const Tag* GetParent(const Scope& scope, const Tag* tag)
+		{
+			return (!tag || tag == scope.m_root) ? nullptr : tag->m_parent;
+		}
+
+		static std::span<Tag* const> GetChilds(const Scope& scope, const Tag* tag)
+		{
+			return tag ? std::span<Tag* const>(tag->m_childs) : scope.m_top;
+		}
+
+		// the tag after tag in document order inside the subtree of root, without a stack
+		static const Tag* GetNext(const Scope& scope, const Tag* tag, const Tag* root)
+		{
+			if (const auto childs = GetChilds(scope, tag); !childs.empty())
+				return childs.front();
+			for (; tag != root; tag = GetParent(scope, tag))
+			{
+				const auto siblings = GetChilds(scope, GetParent(scope, tag));
+				if (const size_t index{ GetSiblingIndex(siblings, tag) }; index + 1 < siblings.size())
+					return siblings[index + 1];
+			}
+			return nullptr;
+		}
+
+		// the position of tag in siblings, m_childIndex unless they were changed by hand or are the top of a subtree;
+		// siblings.size() if tag isn't there
+		static size_t GetSiblingIndex(std::span<Tag* const> siblings, const Tag* tag)
+		{
+			if (tag->m_childIndex < siblings.size() && tag == siblings[tag->m_childIndex])
+				return tag->m_childIndex;
+			return static_cast<size_t>(std::find(siblings.begin(), siblings.end(), tag) - siblings.begin());
+		}
+
+		// the first text child, text() as a string
+		static std::string_view GetText(const Tag* tag)
+		{
+			if (!tag)
+				return {};
+			const auto text = std::find_if(tag->m_childs.begin(), tag->m_childs.end(), [](const Tag* tag) { return tag->m_name.empty(); });
+			return tag->m_childs.end() == text ? std::string_view{} : Trim((*text)->m_value);
+		}
+
+		// the text is compared without the white spaces around it
+		static std::string_view Trim(std::string_view text)
+		{
+			const size_t start{ text.find_first_not_of(whitespace) };
+			if (std::string_view::npos == start)
+				return {};
+			return text.substr(start, text.find_last_not_of(whitespace) - start + 1);
+		}
+
+		// path parsing, m_text is the path being compiled
+		bool ParsePath(Path& path)
+		{
+			if (Skip("//"))
+			{
+				path.m_absolute = true;
+				path.m_steps.push_back({ Axis::descendant_or_self, NodeTest::node });
+			}
+			else if (Skip("/"))
+			{
+				path.m_absolute = true;
+			}
+
+			while (true)
+			{
+				Step step{};
+				if (!ParseStep(step))
+					return false;
+				path.m_steps.push_back(std::move(step));
+				if (Skip("//"))
+					path.m_steps.push_back({ Axis::descendant_or_self, NodeTest::node });
+				else if (!Skip("/"))
+					return true;
+			}
+		}
+
+		bool ParseStep(Step& step)
+		{
+			if (Skip(".."))
+			{
+				step.m_axis = Axis::parent;
+				return true;
+			}
+			if (Skip("."))
+			{
+				step.m_axis = Axis::self;
+				return true;
+			}
+
+			const size_t start{ m_index };
+			const std::string_view axis = ParseName();
+			if (Skip("::"))
+			{
+				const auto it = std::find(axis_names.begin(), axis_names.end(), axis);
+				if (axis_names.end() == it)
 					return false;
+				step.m_axis = static_cast<Axis>(it - axis_names.begin());
+			}
+			else
+			{
+				m_index = start;
 			}
+			if (!ParseNodeTest(step))
+				return false;
 
+			while (Skip("["))
+			{
+				Predicate predicate{};
+				if (!ParsePredicate(predicate) || !Skip("]"))
+					return false;
+				step.m_predicates.push_back(std::move(predicate));
+			}
 			return true;
 		}
 
-		bool ParseValue()
+		bool ParseNodeTest(Step& step)
 		{
-			if (!m_currentTag)
+			if (Skip("*"))
+			{
+				step.m_test = NodeTest::element;
+				return true;
+			}
+			const std::string_view name = ParseName();
+			if (name.empty())
+				return false;
+			if (!Skip("("))
+			{
+				step.m_test = NodeTest::name;
+				step.m_name = Lower(name);
+				step.m_id = GetTagId(name);
+				return true;
+			}
+			if (!Skip(")"))
+				return false;
+			if ("text" == name)
+				step.m_test = NodeTest::text;
+			else if ("comment" == name)
+				step.m_test = NodeTest::comment;
+			else if ("node" == name)
+				step.m_test = NodeTest::node;
+			else
 				return false;
+			return true;
+		}
 
-			std::string value{};
+		bool ParsePredicate(Predicate& predicate)
+		{
+			// [n], [last()] and [last() - n] select by position
+			Term term{ Function::position, Operator::equal };
+			const size_t start{ m_index };
+			if (ParsePosition(term) && IsNext(']'))
+			{
+				predicate.m_position = true;
+				predicate.m_size = term.m_fromLast;
+				predicate.m_groups.push_back({ std::move(term) });
+				return true;
+			}
+			m_index = start;
 
 			do
 			{
-				if (!m_script && !m_style && !m_svg)
+				std::vector<Term> group{};
+				do
 				{
-					while (m_bufferIndex < m_data.length() - 1 && '<' != m_data[m_bufferIndex])
-						value += m_data[m_bufferIndex++];
-					break;
-				}
+					Term term{};
+					if (!ParseTerm(term))
+						return false;
+					predicate.m_position |= (Function::position == term.m_function);
+					predicate.m_size |= term.m_fromLast;
+					group.push_back(std::move(term));
+				} while (SkipWord("and"));
+				predicate.m_groups.push_back(std::move(group));
+			} while (SkipWord("or"));
+			return true;
+		}
 
-				if (m_script)
-				{
-					while (m_bufferIndex < m_data.length() - 5
-						&& !('<' == m_data[m_bufferIndex]
-							&& '/' == m_data[m_bufferIndex + 1]
-							&& 's' == std::tolower(m_data[m_bufferIndex + 2])
-							&& 'c' == std::tolower(m_data[m_bufferIndex + 3])
-							&& 'r' == std::tolower(m_data[m_bufferIndex + 4])))
-						value += m_data[m_bufferIndex++];
-					m_script = false;
-					break;
-				}
+		bool ParseTerm(Term& term)
+		{
+			if (Skip("@"))
+			{
+				term.m_function = Function::attribute;
+				term.m_key = Lower(ParseName());
+				if (term.m_key.empty())
+					return false;
+				return ParseTextComparison(term);
+			}
 
-				if (m_style)
+			const std::string_view name = ParseName();
+			if (!Skip("("))
+				return false;
+			if ("not" == name)
+			{
+				if (!ParseTerm(term) || !Skip(")"))
+					return false;
+				term.m_negate = !term.m_negate;
+				return true;
+			}
+			if ("position" == name)
+			{
+				term.m_function = Function::position;
+				return Skip(")") && ParseOperator(term.m_operator) && ParsePosition(term);
+			}
+			if ("text" == name)
+			{
+				term.m_function = Function::text;
+				return Skip(")") && ParseTextComparison(term);
+			}
+			if ("contains" == name || "starts-with" == name)
+			{
+				term.m_function = ("contains" == name ? Function::contains : Function::starts_with);
+				if (Skip("@"))
 				{
-					while (m_bufferIndex < m_data.length() - 5
-						&& !('<' == m_data[m_bufferIndex]
-							&& '/' == m_data[m_bufferIndex + 1]
-							&& 's' == std::tolower(m_data[m_bufferIndex + 2])
-							&& 't' == std::tolower(m_data[m_bufferIndex + 3])
-							&& 'y' == std::tolower(m_data[m_bufferIndex + 4])))
-						value += m_data[m_bufferIndex++];
-					m_style = false;
-					break;
+					term.m_key = Lower(ParseName());
+					if (term.m_key.empty())
+						return false;
 				}
-
-				if (m_svg)
+				else if (!SkipWord("text") || !Skip("(") || !Skip(")"))
 				{
-					while (m_bufferIndex < m_data.length() - 5
-						&& !('<' == m_data[m_bufferIndex]
-							&& '/' == m_data[m_bufferIndex + 1]
-							&& 's' == std::tolower(m_data[m_bufferIndex + 2])
-							&& 'v' == std::tolower(m_data[m_bufferIndex + 3])
-							&& 'g' == std::tolower(m_data[m_bufferIndex + 4])))
-						value += m_data[m_bufferIndex++];
-					m_svg = false;
+					return false;
 				}
-			} while (false);
+				return Skip(",") && ParseLiteral(term.m_value) && Skip(")");
+			}
+			return false;
+		}
+
+		// n, last() or last() - n
+		bool ParsePosition(Term& term)
+		{
+			if (SkipWord("last"))
+			{
+				if (!Skip("(") || !Skip(")"))
+					return false;
+				term.m_fromLast = true;
+				term.m_number = 0;
+				return !Skip("-") || ParseNumber(term.m_number);
+			}
+			return ParseNumber(term.m_number);
+		}
 
-			Tag tag{};
-			tag.m_parent = m_currentTag;
-			tag.m_value = value;
-			m_currentTag->m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
+		// optional = 'v' or != 'v'
+		bool ParseTextComparison(Term& term)
+		{
+			const size_t start{ m_index };
+			if (!ParseOperator(term.m_operator))
+			{
+				m_index = start;
+				return true;
+			}
+			return (Operator::equal == term.m_operator || Operator::not_equal == term.m_operator) && ParseLiteral(term.m_value);
+		}
 
+		bool ParseOperator(Operator& op)
+		{
+			if (Skip("!="))
+				op = Operator::not_equal;
+			else if (Skip("<="))
+				op = Operator::less_equal;
+			else if (Skip(">="))
+				op = Operator::greater_equal;
+			else if (Skip("="))
+				op = Operator::equal;
+			else if (Skip("<"))
+				op = Operator::less;
+			else if (Skip(">"))
+				op = Operator::greater;
+			else
+				return false;
 			return true;
 		}
 
-		bool ParseSpecialTag()
+		bool ParseLiteral(std::string& value)
 		{
-			Tag tag{};
+			SkipWhiteSpaces();
+			if (m_index >= m_text.size() || ('\"' != m_text[m_index] && '\'' != m_text[m_index]))
+				return false;
+			const char quote{ m_text[m_index++] };
+			const size_t end{ m_text.find(quote, m_index) };
+			if (std::string_view::npos == end)
+				return false;
+			value = m_text.substr(m_index, end - m_index);
+			m_index = end + 1;
+			return true;
+		}
 
-			while (m_bufferIndex < m_data.length() && '>' != m_data[m_bufferIndex])
-				tag.m_name += m_data[m_bufferIndex++];
+		bool ParseNumber(int& value)
+		{
+			SkipWhiteSpaces();
+			const size_t start{ m_index };
+			for (value = 0; m_index < m_text.size() && '0' <= m_text[m_index] && '9' >= m_text[m_index]; ++m_index)
+				value = value * 10 + (m_text[m_index] - '0');
+			return start != m_index;
+		}
 
-			if (m_tags.empty() || !m_currentTag)
-			{
-				m_tags.push_back(std::make_shared<Tag>(std::move(tag)));
-			}
-			else
+		std::string_view ParseName()
+		{
+			SkipWhiteSpaces();
+			const size_t start{ m_index };
+			while (m_index < m_text.size())
 			{
-				tag.m_parent = m_currentTag;
-				tag.m_parent->m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
+				const unsigned char c = static_cast<unsigned char>(m_text[m_index]);
+				if (!(std::isalnum(c) || '-' == c || '_' == c || c >= 0x80))
+					break;
+				m_index++;
 			}
+			return m_text.substr(start, m_index - start);
+		}
 
-			if ('>' == m_data[m_bufferIndex] || m_bufferIndex >= m_data.length())
-				m_bufferIndex++;
-
+		// skip the white spaces and token if the text continues with it
+		bool Skip(std::string_view token)
+		{
+			SkipWhiteSpaces();
+			if (!m_text.substr(m_index).starts_with(token))
+				return false;
+			m_index += token.size();
 			return true;
 		}
 
-		bool ParseCommentTag()
+		bool IsNext(const char c)
 		{
-			Tag tag{};
+			SkipWhiteSpaces();
+			return m_index < m_text.size() && c == m_text[m_index];
+		}
 
-			while (m_bufferIndex < m_data.length() - 3 &&
-				!('>' == m_data[m_bufferIndex]
-					&& '-' == m_data[m_bufferIndex - 1]
-					&& '-' == m_data[m_bufferIndex - 2]))
-				tag.m_name += m_data[m_bufferIndex++];
+		// skip a whole name only
+		bool SkipWord(std::string_view word)
+		{
+			const size_t start{ m_index };
+			if (ParseName() == word)
+				return true;
+			m_index = start;
+			return false;
+		}
 
-			if (m_tags.empty() || !m_currentTag)
-			{
-				m_tags.push_back(std::make_shared<Tag>(std::move(tag)));
-			}
-			else
-			{
-				tag.m_parent = m_currentTag;
-				tag.m_parent->m_childs.push_back(std::make_shared<Tag>(std::move(tag)));
-			}
+		void SkipWhiteSpaces()
+		{
+			m_index = FindFirstNotOf<' ', '\n', '\r', '\t'>(m_text, m_index);
+		}
 
-			if ('>' == m_data[m_bufferIndex] || m_bufferIndex >= m_data.length())
-				m_bufferIndex++;
+		static std::string Lower(std::string_view text)
+		{
+			std::string lower(text);
+			std::transform(lower.begin(), lower.end(), lower.begin(), ToLower);
+			return lower;
+		}
+
+	private:
+		std::vector<Path> m_paths{};	// the paths of the union
+		size_t m_steps{};				// in all the paths, the columns of a walk
+		size_t m_predicates{};
+		std::string_view m_text{};		// while compiling
+		size_t m_index{};
+	};
+
+	// parse many documents at once on a pool of threads, every thread takes its documents from its own
+	// queue and steals from the other queues when its queue is empty
+	class CBatchParser
+	{
+	public:
+		explicit CBatchParser(const ParseOptions& options = {}, size_t threads = 0)
+			: m_options(options)
+		{
+			if (0 == threads)
+				threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+			for (size_t i = 0; i < threads; ++i)
+				m_trees.emplace_back(options);
+		}
+
+	public:
+		size_t GetThreadCount() const { return m_trees.size(); }
+
+		// consumer(index, tree) is called on the thread which parsed documents[index], the tree is
+		// cleared after the call and reused, with its arena, for the next document of the thread
+		template <typename Consumer>
+		void ParseBatch(std::span<const std::string> documents, Consumer&& consumer)
+		{
+			Run(documents.size(), [&](const size_t worker, const size_t index)
+				{
+					CDomTree& tree = m_trees[worker];
+					tree.ParseView(documents[index]);
+					consumer(index, tree);
+					tree.Clear();
+				});
+		}
 
-			return true;
+		// as above, the tree given to consumer is empty if the file can't be read
+		template <typename Consumer>
+		void ParseBatch(std::span<const std::filesystem::path> files, Consumer&& consumer)
+		{
+			Run(files.size(), [&](const size_t worker, const size_t index)
+				{
+					CDomTree& tree = m_trees[worker];
+					tree.ParseFile(files[index]);
+					consumer(index, tree);
+					tree.Clear();
+				});
 		}
 
-		bool ParseOpeningTag()
+		// return the trees in the order of the documents, every tree owns its document and its arena
+		std::vector<CDomTree> ParseBatch(std::vector<std::string>&& documents)
 		{
-			SkipWhiteSpaces();
+			std::vector<CDomTree> trees{};
+			trees.reserve(documents.size());
+			for (size_t i = 0; i < documents.size(); ++i)
+				trees.emplace_back(m_options);
+			Run(documents.size(), [&](const size_t, const size_t index)
+				{
+					trees[index].Parse(std::move(documents[index]));
+				});
+			documents.clear();
+			return trees;
+		}
 
-			std::shared_ptr<Tag> tag = std::make_shared<Tag>();
-			// parse tag name
-			while (m_bufferIndex < m_data.length()
-				&& !IsWhiteSpace(m_data[m_bufferIndex])
-				&& '>' != m_data[m_bufferIndex]
-				&& '/' != m_data[m_bufferIndex])
-				tag->m_name += std::tolower(m_data[m_bufferIndex++]);
+	private:
+		// task(worker, index) for every index below count, the calling thread is the worker 0
+		template <typename Task>
+		void Run(const size_t count, Task&& task)
+		{
+			const size_t workers{ std::min(m_trees.size(), count) };
+			if (workers <= 1)
+			{
+				for (size_t index = 0; index < count; ++index)
+					task(0, index);
+				return;
+			}
 
-			if (std::binary_search(non_valid_tags.cbegin(), non_valid_tags.cend(), tag->m_name))
+			// neighbour documents go to the same queue
+			std::unique_ptr<Queue[]> queues(new Queue[workers]);
+			for (size_t worker = 0; worker < workers; ++worker)
 			{
-				SkipCurrentTag();
-				return true;
+				for (size_t index = count * worker / workers; index < count * (worker + 1) / workers; ++index)
+					queues[worker].m_indexes.push_back(index);
 			}
 
-			const bool isSelfClosingTag = (std::binary_search(self_closing_tags.cbegin(), self_closing_tags.cend(), tag->m_name));
+			const auto work = [&](const size_t worker)
+			{
+				size_t index{};
+				while (queues[worker].PopFront(index) || Steal(queues.get(), workers, worker, index))
+					task(worker, index);
+			};
+			std::vector<std::thread> threads{};
+			threads.reserve(workers - 1);
+			for (size_t worker = 1; worker < workers; ++worker)
+				threads.emplace_back(work, worker);
+			work(0);
+			for (auto& thread : threads)
+				thread.join();
+		}
 
-			if (m_tags.empty() || !m_currentTag)
+		struct Queue
+		{
+			bool PopFront(size_t& index)
 			{
-				m_tags.push_back(tag);
-				m_currentTag = m_tags.back().get();
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_indexes.empty())
+					return false;
+				index = m_indexes.front();
+				m_indexes.pop_front();
+				return true;
 			}
-			else
+			bool PopBack(size_t& index)
 			{
-				if (!isSelfClosingTag && IsWatched(tag->m_name))
-					PerformCorrectnessOnOpen(tag->m_name);
-
-				if (m_currentTag)
-				{
-					tag->m_parent = m_currentTag;							// put m_currentTag to local tag as parent
-					tag->m_parent->m_childs.push_back(tag);					// add to local tag parent childs the actual local tag
-					m_currentTag = tag->m_parent->m_childs.back().get();	// setup m_currentTag as local tag
-					SetupMultiLineTags();
-				}
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_indexes.empty())
+					return false;
+				index = m_indexes.back();
+				m_indexes.pop_back();
+				return true;
 			}
 
-			ParseAttributes();
+			std::mutex m_mutex{};
+			std::deque<size_t> m_indexes{};
+		};
 
-			if (isSelfClosingTag)
-			{
-				m_currentTag = m_currentTag->m_parent;
-			}
-			else if (IsWatched(m_currentTag->m_name))
+		// take the last document of another queue, no document is added during a batch
+		// so all the queues are done when there is nothing to steal
+		static bool Steal(Queue* queues, const size_t workers, const size_t worker, size_t& index)
+		{
+			for (size_t i = 1; i < workers; ++i)
 			{
-				UpdateWatched(m_currentTag->m_name, TagState::opened);
+				if (queues[(worker + i) % workers].PopBack(index))
+					return true;
 			}
+			return false;
+		}
 
-			if ('>' == m_data[m_bufferIndex] || m_bufferIndex >= m_data.length())
-				m_bufferIndex++;
+	private:
+		ParseOptions m_options{};
+		std::vector<CDomTree> m_trees{};	// one per thread, reused from batch to batch
+	};
 
-			return true;
-		}
+	// flat copy of a tag forest: one node table linked by indexes, with names, texts and attributes
+	// kept in separate tables, so the tree can be walked without chasing pointers, copied or serialized;
+	// it is walked through FlatTag handles, CDomTree::ViewFlatTree gives CTagWriter, CSelector, CXPath and
+	// the tag iterators tags which view its tables
+	class CFlatTree
+	{
+	public:
+		static constexpr uint32_t npos{ 0xFFFFFFFF };
 
-		void ParseClosingTag()
+		struct Range
 		{
-			SkipWhiteSpaces();
-
-			std::string tagName{};
-			while (m_bufferIndex < m_data.length() && !IsWhiteSpace(m_data[m_bufferIndex]) && '>' != m_data[m_bufferIndex])
-				tagName += std::tolower(m_data[m_bufferIndex++]);
+			uint32_t m_offset{};
+			uint32_t m_length{};
+		};
 
-			if ('>' == m_data[m_bufferIndex] || m_data[m_bufferIndex] >= m_data.length())
-				m_bufferIndex++;
+		struct FlatAttribute
+		{
+			Range m_key{};		// into the string table
+			Range m_value{};	// into the string table
+			char m_quote{ '\"' };
+		};
 
-			if (binary_search(non_valid_tags.cbegin(), non_valid_tags.cend(), tagName))
-				return;
+		class FlatTagRange;
 
-			if (m_currentTag)
+		// lightweight handle to a node, the counterpart of Tag
+		class FlatTag
+		{
+		public:
+			FlatTag() = default;
+			FlatTag(const CFlatTree* tree, const uint32_t index)
+				: m_tree(tree)
+				, m_index(index)
 			{
-				bool valid_close{ true };
-				if (IsWatched(tagName))
-				{
-					UpdateWatched(tagName, TagState::closed);
-					PerformCorrectnessOnClose(tagName);
-					valid_close = CloseParagraphes(tagName);
-				}
-				if (m_currentTag && valid_close)
-					m_currentTag = m_currentTag->m_parent;
-				if ("table" == tagName && !m_tables.empty())
-					RestoreCurrentTable();
 			}
-		}
-		// corrected tags: tr, td
-		void PerformCorrectnessOnOpen(const std::string& tagName)
+
+		public:
+			explicit operator bool() const { return m_tree && npos != m_index; }
+			bool operator==(const FlatTag& rhs) const = default;
+			uint32_t GetIndex() const { return m_index; }
+			std::string_view GetName() const { return m_tree->GetName(m_index); }
+			std::string_view GetValue() const { return m_tree->GetValue(m_index); }
+			std::span<const FlatAttribute> GetAttributes() const { return m_tree->GetAttributes(m_index); }
+			FlatTag GetParent() const { return { m_tree, m_tree->GetParent(m_index) }; }
+			FlatTagRange GetChilds() const { return { m_tree, m_tree->GetFirstChild(m_index) }; }
+
+		private:
+			const CFlatTree* m_tree{};
+			uint32_t m_index{ npos };
+		};
+
+		// siblings starting with a given node, in document order
+		class FlatTagRange
 		{
-			if ("td" == tagName)
+		public:
+			class Iterator
 			{
-				if (TagState::opened == m_td && m_currentTag)
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = FlatTag;
+				using difference_type = std::ptrdiff_t;
+				using pointer = void;
+				using reference = FlatTag;
+
+			public:
+				Iterator() = default;
+				Iterator(const CFlatTree* tree, const uint32_t index)
+					: m_tree(tree)
+					, m_index(index)
 				{
-					m_currentTag = m_currentTag->m_parent;
-					m_td = TagState::closed;
 				}
-				return;
-			}
-			if ("tr" == tagName)
-			{
-				if (TagState::opened == m_td && m_currentTag)
+				FlatTag operator*() const { return { m_tree, m_index }; }
+				Iterator& operator++()
 				{
-					m_currentTag = m_currentTag->m_parent;
-					m_td = TagState::closed;
+					m_index = m_tree->GetNextSibling(m_index);
+					return *this;
 				}
-				if (TagState::opened == m_tr && m_currentTag)
+				Iterator operator++(int)
 				{
-					m_currentTag = m_currentTag->m_parent;
-					m_tr = TagState::closed;
+					Iterator it{ *this };
+					++*this;
+					return it;
 				}
-				return;
-			}
-			if ("table" == tagName && TagState::opened == m_td && m_currentTag)
+				bool operator==(const Iterator& rhs) const { return m_index == rhs.m_index; }
+
+			private:
+				const CFlatTree* m_tree{};
+				uint32_t m_index{ npos };
+			};
+
+		public:
+			FlatTagRange() = default;
+			FlatTagRange(const CFlatTree* tree, const uint32_t first)
+				: m_tree(tree)
+				, m_first(first)
 			{
-				m_tables.push({ m_table, m_tr, m_td });
-				m_tr = m_td = TagState::closed;
-				m_table = TagState::opened;
-				return;
 			}
+			Iterator begin() const { return { m_tree, m_first }; }
+			Iterator end() const { return { m_tree, npos }; }
+			bool empty() const { return npos == m_first; }
+			size_t size() const { return static_cast<size_t>(std::distance(begin(), end())); }
+
+		private:
+			const CFlatTree* m_tree{};
+			uint32_t m_first{ npos };
+		};
+
+	public:
+		static constexpr uint32_t snapshot_version{ 1 };
+
+		// header of a snapshot, followed by the columns in the order of Columns, each padded to 8 bytes
+		struct SnapshotHeader
+		{
+			char m_magic[4]{ 'D', 'O', 'M', 'T' };
+			uint32_t m_version{ snapshot_version };
+			uint32_t m_byteOrder{ 0x01020304 };
+			uint32_t m_attributeSize{ sizeof(FlatAttribute) };
+			uint64_t m_nodes{};
+			uint64_t m_attributes{};
+			uint64_t m_names{};
+			uint64_t m_strings{};
+		};
+
+	public:
+		CFlatTree() = default;
+		explicit CFlatTree(const std::vector<Tag*>& tags)
+		{
+			Build(tags);
+		}
+		explicit CFlatTree(const CDomTree& tree)
+			: CFlatTree(tree.GetTags())
+		{
+		}
+		CFlatTree(const CFlatTree& rhs)
+			: m_parent(rhs.m_parent)
+			, m_firstChild(rhs.m_firstChild)
+			, m_nextSibling(rhs.m_nextSibling)
+			, m_nameId(rhs.m_nameId)
+			, m_value(rhs.m_value)
+			, m_attributeRange(rhs.m_attributeRange)
+			, m_attributes(rhs.m_attributes)
+			, m_names(rhs.m_names)
+			, m_strings(rhs.m_strings)
+			, m_snapshot(rhs.m_snapshot)
+			, m_view(rhs.m_view)
+		{
+			AttachColumns(rhs);
 		}
-		// corrected tags: table
-		void PerformCorrectnessOnClose(const std::string& tagName)
+		CFlatTree& operator=(const CFlatTree& rhs)
 		{
-			if ("table" == tagName)
+			if (this != &rhs)
 			{
-				if (TagState::opened == m_td && m_currentTag)
-				{
-					m_currentTag = m_currentTag->m_parent;
-					m_td = TagState::closed;
-				}
-				if (TagState::opened == m_tr && m_currentTag)
-				{
-					m_currentTag = m_currentTag->m_parent;
-					m_tr = TagState::closed;
-				}
-				return;
+				m_parent = rhs.m_parent;
+				m_firstChild = rhs.m_firstChild;
+				m_nextSibling = rhs.m_nextSibling;
+				m_nameId = rhs.m_nameId;
+				m_value = rhs.m_value;
+				m_attributeRange = rhs.m_attributeRange;
+				m_attributes = rhs.m_attributes;
+				m_names = rhs.m_names;
+				m_strings = rhs.m_strings;
+				m_snapshot = rhs.m_snapshot;
+				m_view = rhs.m_view;
+				AttachColumns(rhs);
 			}
+			return *this;
 		}
-
-		void ParseAttributes()
+		CFlatTree(CFlatTree&& rhs) noexcept
+			: m_parent(std::move(rhs.m_parent))
+			, m_firstChild(std::move(rhs.m_firstChild))
+			, m_nextSibling(std::move(rhs.m_nextSibling))
+			, m_nameId(std::move(rhs.m_nameId))
+			, m_value(std::move(rhs.m_value))
+			, m_attributeRange(std::move(rhs.m_attributeRange))
+			, m_attributes(std::move(rhs.m_attributes))
+			, m_names(std::move(rhs.m_names))
+			, m_strings(std::move(rhs.m_strings))
+			, m_snapshot(std::move(rhs.m_snapshot))
+			, m_view(rhs.m_view)
 		{
-			char quote{ '\"' };
-			while (m_bufferIndex < m_data.length() && '>' != m_data[m_bufferIndex])
+			AttachColumns(rhs);
+			rhs.Clear();
+		}
+		CFlatTree& operator=(CFlatTree&& rhs) noexcept
+		{
+			if (this != &rhs)
 			{
-				SkipWhiteSpaces();
-
-				if (m_bufferIndex < m_data.length() && '>' != m_data[m_bufferIndex] && '/' != m_data[m_bufferIndex])
-				{
-					std::string key{}, value{};
-					while (m_bufferIndex < m_data.length()
-						&& '=' != m_data[m_bufferIndex]
-						&& '>' != m_data[m_bufferIndex]
-						&& !IsWhiteSpace(m_data[m_bufferIndex]))
-						key += m_data[m_bufferIndex++];
-
-					SkipWhiteSpaces();
-					if (m_bufferIndex < m_data.length() && '=' == m_data[m_bufferIndex])
-					{
-						m_bufferIndex++;
-						SkipWhiteSpaces();
-						if (m_bufferIndex < m_data.length() && ('\"' == m_data[m_bufferIndex] || '\'' == m_data[m_bufferIndex]))
-						{
-							quote = m_data[m_bufferIndex++];
-							while (m_bufferIndex < m_data.length() && quote != m_data[m_bufferIndex])
-								value += m_data[m_bufferIndex++];
-						}
-					}
-					else
-					{
-						m_bufferIndex--;
-					}
-					m_currentTag->m_attributes.push_back(Attribute{ key, value, quote });
-				}
-
-				if ('>' != m_data[m_bufferIndex])
-					m_bufferIndex++;
+				m_parent = std::move(rhs.m_parent);
+				m_firstChild = std::move(rhs.m_firstChild);
+				m_nextSibling = std::move(rhs.m_nextSibling);
+				m_nameId = std::move(rhs.m_nameId);
+				m_value = std::move(rhs.m_value);
+				m_attributeRange = std::move(rhs.m_attributeRange);
+				m_attributes = std::move(rhs.m_attributes);
+				m_names = std::move(rhs.m_names);
+				m_strings = std::move(rhs.m_strings);
+				m_snapshot = std::move(rhs.m_snapshot);
+				m_view = rhs.m_view;
+				AttachColumns(rhs);
+				rhs.Clear();
 			}
+			return *this;
 		}
+		~CFlatTree() = default;
 
-		void SkipWhiteSpaces()
-		{
-			while (m_bufferIndex < m_data.length() && IsWhiteSpace(m_data[m_bufferIndex]))
-				m_bufferIndex++;
-		}
+	public:
+		// the root tags, the view on top of the flat table equivalent to CDomTree::GetTags()
+		FlatTagRange GetTags() const { return { this, m_columns.m_parent.empty() ? npos : 0 }; }
+		FlatTag GetTag(const uint32_t node) const { return { this, node }; }
+		size_t GetCount() const { return m_columns.m_parent.size(); }
+		// true if the tables are views into a loaded snapshot
+		bool IsSnapshot() const { return m_view; }
 
-		constexpr bool IsWhiteSpace(const char c) const
+		uint32_t GetParent(const uint32_t node) const { return m_columns.m_parent[node]; }
+		uint32_t GetFirstChild(const uint32_t node) const { return m_columns.m_firstChild[node]; }
+		uint32_t GetNextSibling(const uint32_t node) const { return m_columns.m_nextSibling[node]; }
+		uint32_t GetNameId(const uint32_t node) const { return m_columns.m_nameId[node]; }
+		std::string_view GetName(const uint32_t node) const { return GetText(m_columns.m_names[m_columns.m_nameId[node]]); }
+		std::string_view GetNameById(const uint32_t id) const { return GetText(m_columns.m_names[id]); }
+		std::string_view GetValue(const uint32_t node) const { return GetText(m_columns.m_value[node]); }
+		std::span<const FlatAttribute> GetAttributes(const uint32_t node) const
 		{
-			return (' ' == c || '\r' == c || '\n' == c || '\t' == c);
+			return m_columns.m_attributes.subspan(m_columns.m_attributeRange[node].m_offset, m_columns.m_attributeRange[node].m_length);
 		}
-
-		std::string GetIndent(size_t tabs) const
+		std::string_view GetText(const Range& range) const
 		{
-			std::ostringstream buffer{};
-			while (tabs--)
-				buffer << "\t";
-			return buffer.str();
+			return m_columns.m_strings.substr(range.m_offset, range.m_length);
 		}
-
-		void PrintData(const std::vector<std::shared_ptr<Tag>>& tags, std::string& data, const size_t level = 0) const
+		// return npos if no node has this name
+		uint32_t FindNameId(std::string_view name) const
 		{
-			for (const auto& it : tags)
+			for (uint32_t id = 0; id < m_columns.m_names.size(); ++id)
 			{
-				if (it->m_name.empty())
-					continue;
-
-				if ('!' != it->m_name.front() && '?' != it->m_name.front())
-				{
-					PrintName(*it, data, level);
-					PrintValue(*it, data, level);
-					PrintClose(*it, data, level);
-				}
-				else
-				{
-					if (!data.empty())
-						data += "\n";
-					data += GetIndent(level) + "<" + it->m_name + ">";
-				}
+				if (GetText(m_columns.m_names[id]) == name)
+					return id;
 			}
+			return npos;
 		}
 
-		void PrintName(const Tag& tag, std::string& data, const size_t level) const
+		void Clear()
 		{
-			if (!data.empty())
-				data += "\n";
-			data += GetIndent(level) + "<" + tag.m_name;
-			for (const auto& attr : tag.m_attributes)
-				data += " " + attr.m_key + "=" + attr.m_quote + attr.m_value + attr.m_quote;
-
-			if (std::binary_search(self_closing_tags.cbegin(), self_closing_tags.cend(), tag.m_name))
-				data += "/";
-			data += ">";
+			m_parent.clear();
+			m_firstChild.clear();
+			m_nextSibling.clear();
+			m_nameId.clear();
+			m_value.clear();
+			m_attributeRange.clear();
+			m_attributes.clear();
+			m_names.clear();
+			m_strings.clear();
+			m_snapshot.reset();
+			m_view = false;
+			AttachColumns();
 		}
 
-		void PrintValue(const Tag& tag, std::string& data, const size_t level) const
+		// write the tables as a snapshot which Load maps back without parsing
+		template <typename Sink>
+		void WriteSnapshot(Sink& sink) const
 		{
-			if (0 == tag.m_childs.size())
+			SnapshotHeader header{};
+			header.m_nodes = m_columns.m_parent.size();
+			header.m_attributes = m_columns.m_attributes.size();
+			header.m_names = m_columns.m_names.size();
+			header.m_strings = m_columns.m_strings.size();
+			WriteColumn(sink, std::span<const SnapshotHeader>(&header, 1));
+			WriteColumn(sink, m_columns.m_parent);
+			WriteColumn(sink, m_columns.m_firstChild);
+			WriteColumn(sink, m_columns.m_nextSibling);
+			WriteColumn(sink, m_columns.m_nameId);
+			WriteColumn(sink, m_columns.m_value);
+			WriteColumn(sink, m_columns.m_attributeRange);
+			// the padding of FlatAttribute is written as zero
+			std::vector<char> attributes(m_columns.m_attributes.size_bytes(), 0);
+			for (size_t i = 0; i < m_columns.m_attributes.size(); ++i)
 			{
-				data += tag.m_value.substr(0, tag.m_value.find_last_not_of(whitespace) + 1);
-				return;
+				const FlatAttribute& attr = m_columns.m_attributes[i];
+				char* out = attributes.data() + i * sizeof(FlatAttribute);
+				std::memcpy(out + offsetof(FlatAttribute, m_key), &attr.m_key, sizeof(Range));
+				std::memcpy(out + offsetof(FlatAttribute, m_value), &attr.m_value, sizeof(Range));
+				out[offsetof(FlatAttribute, m_quote)] = attr.m_quote;
 			}
+			WriteColumn(sink, std::span<const char>(attributes));
+			WriteColumn(sink, m_columns.m_names);
+			WriteColumn(sink, std::span<const char>(m_columns.m_strings.data(), m_columns.m_strings.size()));
+		}
+		// return false if the file can't be written
+		bool SaveSnapshot(const std::filesystem::path& path) const
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+			StreamSink sink{ file };
+			WriteSnapshot(sink);
+			return static_cast<bool>(file.flush());
+		}
 
-			for (auto&& it : tag.m_childs)
-			{
-				if (it->m_name.empty())	// is value
-				{
-					if (1 == tag.m_childs.size() &&
-						tag.m_childs.front()->m_name.empty() &&
-						"script" != tag.m_name &&
-						"svg" != tag.m_name &&
-						"style" != tag.m_name)
-						data += it->m_value.substr(0, it->m_value.find_last_not_of(whitespace) + 1);
-					else
-						data += "\n" + GetIndent(level + 1) + it->m_value.substr(0, it->m_value.find_last_not_of(whitespace) + 1);
-				}
-				else
-				{
-					PrintData({ it }, data, level + 1);
-				}
-			}
+		// map a snapshot written by SaveSnapshot, the tables are views into the mapping which the tree keeps;
+		// return false, leaving the tree empty, if the file can't be mapped or isn't a valid snapshot of this
+		// version: one pass over the tables checks that the nodes form a forest and that every index and range
+		// points inside its table, so a loaded tree is walked and read without checks
+		bool LoadSnapshot(const std::filesystem::path& path)
+		{
+			Clear();
+			auto mapping = std::make_shared<CFileMapping>(path);
+			if (!mapping->IsOpen() || !AttachSnapshot(mapping->GetData()))
+				return false;
+			m_snapshot = std::move(mapping);
+			return true;
+		}
+		// as LoadSnapshot from a snapshot in memory, the caller keeps it alive and 8 bytes aligned
+		bool LoadSnapshotView(std::string_view snapshot)
+		{
+			Clear();
+			return AttachSnapshot(snapshot);
 		}
 
-		void PrintClose(const Tag& tag, std::string& data, const size_t level) const
+		// nodes are stored in document order, so the first child of a node is the next node;
+		// throws std::length_error, leaving the tree empty, if a table outgrows the uint32_t indexes
+		void Build(const std::vector<Tag*>& tags)
 		{
-			if (!std::binary_search(self_closing_tags.cbegin(), self_closing_tags.cend(), tag.m_name))
+			Clear();
+			try
+			{
+				BuildTables(tags);
+			}
+			catch (...)
 			{
-				if (tag.m_childs.size() > 1 || (0 != tag.m_childs.size() && !tag.m_childs.front()->m_name.empty()) ||
-					"script" == tag.m_name || "svg" == tag.m_name || "style" == tag.m_name)
-					data += "\n" + GetIndent(level);
-				data += "</" + tag.m_name + ">";
+				Clear();
+				throw;
 			}
+			AttachColumns();
 		}
 
 	private:
-		enum class TagState
+		// views on the tables, either the owned vectors or a loaded snapshot
+		struct Columns
 		{
-			closed = 0,
-			opened
+			std::span<const uint32_t> m_parent{};
+			std::span<const uint32_t> m_firstChild{};
+			std::span<const uint32_t> m_nextSibling{};
+			std::span<const uint32_t> m_nameId{};
+			std::span<const Range> m_value{};
+			std::span<const Range> m_attributeRange{};
+			std::span<const FlatAttribute> m_attributes{};
+			std::span<const Range> m_names{};
+			std::string_view m_strings{};
 		};
 
 	private:
-		void SetupMultiLineTags()
+		void BuildTables(const std::vector<Tag*>& tags)
 		{
-			m_script = m_style = m_svg = false;
-			if ("script" == m_currentTag->m_name)
-			{
-				m_script = true;
-				return;
-			}
-			if ("style" == m_currentTag->m_name)
+			std::unordered_map<std::string_view, uint32_t> names{};
+			names.emplace(std::string_view{}, 0);
+			m_names.push_back({});
+
+			struct Item
 			{
-				m_style = true;
-				return;
-			}
-			if ("svg" == m_currentTag->m_name)
+				const Tag* m_tag{};
+				uint32_t m_parent{ npos };
+			};
+			std::vector<Item> stack{};
+			std::vector<uint32_t> lastChild{};
+			uint32_t lastRoot{ npos };
+			for (auto it = tags.rbegin(); it != tags.rend(); ++it)
+				stack.push_back({ *it, npos });
+
+			while (!stack.empty())
 			{
-				m_svg = true;
+				const Item item{ stack.back() };
+				stack.pop_back();
+
+				CheckSize(m_parent.size() + 1);
+				const uint32_t node = static_cast<uint32_t>(m_parent.size());
+				m_parent.push_back(item.m_parent);
+				m_firstChild.push_back(npos);
+				m_nextSibling.push_back(npos);
+				lastChild.push_back(npos);
+
+				uint32_t& previous = (npos == item.m_parent ? lastRoot : lastChild[item.m_parent]);
+				if (npos != previous)
+					m_nextSibling[previous] = node;
+				else if (npos != item.m_parent)
+					m_firstChild[item.m_parent] = node;
+				previous = node;
+
+				const auto name = names.try_emplace(item.m_tag->m_name.view(), static_cast<uint32_t>(m_names.size()));
+				if (name.second)
+					m_names.push_back(AddText(item.m_tag->m_name));
+				m_nameId.push_back(name.first->second);
+				m_value.push_back(AddText(item.m_tag->m_value));
+
+				CheckSize(m_attributes.size() + item.m_tag->m_attributes.size());
+				m_attributeRange.push_back({ static_cast<uint32_t>(m_attributes.size()), static_cast<uint32_t>(item.m_tag->m_attributes.size()) });
+				for (const auto& attr : item.m_tag->m_attributes)
+					m_attributes.push_back({ AddText(attr.m_key), AddText(attr.m_value), attr.m_quote });
+
+				for (auto it = item.m_tag->m_childs.rbegin(); it != item.m_tag->m_childs.rend(); ++it)
+					stack.push_back({ *it, node });
 			}
 		}
-		// watched tags: p, a, table, tr, td
-		bool IsWatched(const std::string& tag) const
+
+		// a table of size entries is indexed with uint32_t, the string table with the ranges which end in it
+		static void CheckSize(const size_t size)
 		{
-			if ("p" == tag || "a" == tag || "td" == tag || "tr" == tag || "table" == tag || "label" == tag)
-				return true;
-			return false;
+			if (size > npos)
+				throw std::length_error("CFlatTree: a table is larger than the uint32_t indexes");
 		}
-		// update tags: table, tr, td
-		// tags updated on open only: p, a 
-		void UpdateWatched(const std::string& tagName, TagState state)
+
+		Range AddText(std::string_view text)
 		{
-			if ("p" == tagName && TagState::opened == state)	// update the p tag at openning only
-			{
-				m_p = state;
-				return;
-			}
-			if ("a" == tagName && TagState::opened == state)	// update the a tag at openning only
-			{
-				m_a = state;
-				return;
-			}
-			if ("td" == tagName)
-			{
-				m_td = state;
-				return;
-			}
-			if ("tr" == tagName)
-			{
-				m_tr = state;
-				return;
-			}
-			if ("table" == tagName)
-			{
-				m_table = state;
-				return;
-			}
-			if ("label" == tagName && TagState::opened == state)
-			{
-				m_label = state;
-				return;
-			}
+			CheckSize(m_strings.size() + text.size());
+			const Range range{ static_cast<uint32_t>(m_strings.size()), static_cast<uint32_t>(text.size()) };
+			m_strings.append(text);
+			return range;
+		}
+
+		void AttachColumns()
+		{
+			m_columns = { m_parent, m_firstChild, m_nextSibling, m_nameId, m_value, m_attributeRange, m_attributes, m_names, m_strings };
+		}
+		// after a copy or a move from rhs, a snapshot is shared, owned tables are attached again
+		void AttachColumns(const CFlatTree& rhs)
+		{
+			if (m_view)
+				m_columns = rhs.m_columns;
+			else
+				AttachColumns();
+		}
+
+		bool AttachSnapshot(std::string_view snapshot)
+		{
+			SnapshotHeader header{};
+			if (snapshot.size() < sizeof(header) || 0 != reinterpret_cast<uintptr_t>(snapshot.data()) % alignof(uint64_t))
+				return false;
+			std::memcpy(&header, snapshot.data(), sizeof(header));
+			const SnapshotHeader expected{};
+			if (0 != std::memcmp(header.m_magic, expected.m_magic, sizeof(header.m_magic)) ||
+				expected.m_version != header.m_version ||
+				expected.m_byteOrder != header.m_byteOrder ||
+				expected.m_attributeSize != header.m_attributeSize)
+				return false;
+
+			size_t offset{ sizeof(header) };
+			Columns columns{};
+			if (!ReadColumn(snapshot, offset, header.m_nodes, columns.m_parent) ||
+				!ReadColumn(snapshot, offset, header.m_nodes, columns.m_firstChild) ||
+				!ReadColumn(snapshot, offset, header.m_nodes, columns.m_nextSibling) ||
+				!ReadColumn(snapshot, offset, header.m_nodes, columns.m_nameId) ||
+				!ReadColumn(snapshot, offset, header.m_nodes, columns.m_value) ||
+				!ReadColumn(snapshot, offset, header.m_nodes, columns.m_attributeRange) ||
+				!ReadColumn(snapshot, offset, header.m_attributes, columns.m_attributes) ||
+				!ReadColumn(snapshot, offset, header.m_names, columns.m_names))
+				return false;
+			std::span<const char> strings{};
+			if (!ReadColumn(snapshot, offset, header.m_strings, strings))
+				return false;
+			columns.m_strings = std::string_view(strings.data(), strings.size());
+			if (!IsValid(columns))
+				return false;
+			m_columns = columns;
+			m_view = true;
+			return true;
 		}
-		// return false if the current closing tag should remain at the same level
-		bool CloseParagraphes(const std::string& tagName)
+
+		// the nodes form a forest in which a link goes to a later node: the first node is a root, every other
+		// node is the first child or the next sibling of exactly one node, which is its parent or has the same
+		// parent; the names, the texts and the attributes are inside their tables
+		static bool IsValid(const Columns& columns)
 		{
-			if ("p" == tagName)
+			const auto isInside = [](const Range& range, const size_t size)
+				{
+					return range.m_offset <= size && range.m_length <= size - range.m_offset;
+				};
+			const size_t nodes{ columns.m_parent.size() };
+			if (nodes && npos != columns.m_parent[0])
+				return false;
+			std::vector<bool> linked(nodes, false);
+			for (uint32_t node = 0; node < nodes; ++node)
 			{
-				if (TagState::opened == m_p)
-					m_p = TagState::closed;
-				else
+				const uint32_t parent{ columns.m_parent[node] };
+				if (npos != parent && parent >= node)
+					return false;
+				if (const uint32_t first{ columns.m_firstChild[node] }; npos != first)
+				{
+					if (first <= node || first >= nodes || node != columns.m_parent[first] || linked[first])
+						return false;
+					linked[first] = true;
+				}
+				if (const uint32_t next{ columns.m_nextSibling[node] }; npos != next)
+				{
+					if (next <= node || next >= nodes || parent != columns.m_parent[next] || linked[next])
+						return false;
+					linked[next] = true;
+				}
+				if (columns.m_nameId[node] >= columns.m_names.size() ||
+					!isInside(columns.m_value[node], columns.m_strings.size()) ||
+					!isInside(columns.m_attributeRange[node], columns.m_attributes.size()))
 					return false;
 			}
-			if ("a" == tagName)
+			for (size_t node = 1; node < nodes; ++node)
 			{
-				if (TagState::opened == m_a)
-					m_a = TagState::closed;
-				else
+				if (!linked[node])
 					return false;
 			}
-			if ("label" == tagName)
+			for (const FlatAttribute& attr : columns.m_attributes)
 			{
-				if (TagState::opened == m_label)
-					m_label = TagState::closed;
-				else
+				if (!isInside(attr.m_key, columns.m_strings.size()) || !isInside(attr.m_value, columns.m_strings.size()))
+					return false;
+			}
+			for (const Range& name : columns.m_names)
+			{
+				if (!isInside(name, columns.m_strings.size()))
 					return false;
 			}
 			return true;
 		}
-		// restore the current table state
-		void RestoreCurrentTable()
+
+		template <typename Sink, typename T>
+		static void WriteColumn(Sink& sink, std::span<const T> column)
 		{
-			m_table = m_tables.top().m_table;
-			m_tr = m_tables.top().m_tr;
-			m_td = m_tables.top().m_td;
-			m_tables.pop();
-		}
-		// skip the current tag
-		void SkipCurrentTag() { while (m_bufferIndex < m_data.length() && '>' != m_data[m_bufferIndex])
-				m_bufferIndex++;
-			if ('>' == m_data[m_bufferIndex] || m_bufferIndex >= m_data.length())
-				m_bufferIndex++;
+			constexpr char padding[8]{};
+			sink.Write(std::string_view(reinterpret_cast<const char*>(column.data()), column.size_bytes()));
+			sink.Write(std::string_view(padding, (8 - column.size_bytes() % 8) % 8));
 		}
 
-	private:
-		struct TableState
+		template <typename T>
+		static bool ReadColumn(std::string_view snapshot, size_t& offset, const uint64_t count, std::span<const T>& column)
 		{
-			TagState m_table{ TagState::closed };
-			TagState m_tr{ TagState::closed };
-			TagState m_td{ TagState::closed };
-		};
-
-	private:
-		std::string m_data{};
-		std::stack<TableState> m_tables;
-		std::vector<std::shared_ptr<Tag>> m_tags{};
-		size_t m_bufferIndex{};
-		Tag* m_currentTag{};
-
-	// tags for correctness
-	private:
-		TagState m_td{ TagState::closed };
-		TagState m_tr{ TagState::closed };
-		TagState m_table{ TagState::closed };
-		TagState m_p{ TagState::closed };	// paragraph tag
-		TagState m_a{ TagState::closed };
-		TagState m_label{ TagState::closed };
+			if (count > (snapshot.size() - offset) / sizeof(T))
+				return false;
+			column = std::span<const T>(reinterpret_cast<const T*>(snapshot.data() + offset), static_cast<size_t>(count));
+			offset += (column.size_bytes() + 7) / 8 * 8;
+			offset = std::min(offset, snapshot.size());
+			return true;
+		}
 
-	// multilines tags
 	private:
-		bool m_svg{ false };
-		bool m_style{ false };
-		bool m_script{ false };
+		// tables built from tags, one entry per node
+		std::vector<uint32_t> m_parent{};
+		std::vector<uint32_t> m_firstChild{};
+		std::vector<uint32_t> m_nextSibling{};
+		std::vector<uint32_t> m_nameId{};
+		std::vector<Range> m_value{};
+		std::vector<Range> m_attributeRange{};	// into m_attributes
+		// attribute, name and string tables
+		std::vector<FlatAttribute> m_attributes{};
+		std::vector<Range> m_names{};
+		std::string m_strings{};
+		Columns m_columns{};
+		std::shared_ptr<const CFileMapping> m_snapshot{};	// mapping of a loaded snapshot, shared by the copies
+		bool m_view{ false };	// m_columns view a loaded snapshot, mapped or kept by the caller, not the vectors
 	};
+
+	inline void CDomTree::ViewFlatTree(const CFlatTree& flat)
+	{
+		RetainDocument();
+		if (!m_arena)
+			m_arena = std::make_unique<CTagArena>();
+		m_arena->SetDecoded(m_options.m_decodeEntities);
+		PrepareTagIndex();
+		m_attributeIndex.m_valid = false;
+		// the nodes are in document order, a parent comes before its childs and a sibling after the previous one
+		std::vector<Tag*> tags(flat.GetCount());
+		for (uint32_t node = 0; node < tags.size(); ++node)
+		{
+			Tag* tag = m_arena->Create();
+			const std::string_view name{ flat.GetName(node) };
+			tag->m_name = CDomString::View(name);
+			tag->m_id = GetTagId(name);
+			tag->m_value = CDomString::View(flat.GetValue(node));
+			const std::span<const CFlatTree::FlatAttribute> attributes{ flat.GetAttributes(node) };
+			tag->m_attributes.reserve(attributes.size());
+			for (const auto& attr : attributes)
+			{
+				const std::string_view key{ flat.GetText(attr.m_key) };
+				const AttributeId id{ GetAttributeId(key) };
+				tag->m_attributes.emplace_back(AttributeId::unknown != id ? CDomString::View(attribute_names[static_cast<size_t>(id)]) : CDomString::View(key),
+					CDomString::View(flat.GetText(attr.m_value)), attr.m_quote, id);
+			}
+			const uint32_t parent{ flat.GetParent(node) };
+			AppendTag(CFlatTree::npos == parent ? nullptr : tags[parent], tag);
+			if (m_tagIndex.m_valid)
+				m_tagIndex.Add(tag);
+			tags[node] = tag;
+		}
+	}
 }
+
+// the iterators of a CTagRange point into the tree, not into the range
+template <typename Iterator>
+inline constexpr bool std::ranges::enable_borrowed_range<domtree::CTagRange<Iterator>> = true;
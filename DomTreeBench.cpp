@@ -0,0 +1,286 @@
+// DomTreeBench.cpp : parse, serialize and traversal benchmarks over the html files.
+// Usage: DomTreeBench [html folder] [seconds per benchmark]
+//
+
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "DomTree.h"
+
+using namespace domtree;
+
+// heap statistics, every allocation of the process goes through the operators below
+namespace
+{
+	struct HeapStats
+	{
+		std::atomic<size_t> m_allocations{};
+		std::atomic<size_t> m_bytes{};
+		std::atomic<size_t> m_live{};
+		std::atomic<size_t> m_peak{};
+	};
+
+	HeapStats heap_stats{};
+
+	// every block starts with its size, so the live bytes are known when it is released
+	constexpr size_t heap_header{ alignof(std::max_align_t) };
+
+	void* Allocate(const size_t size)
+	{
+		void* block = std::malloc(size + heap_header);
+		if (!block)
+			return nullptr;
+		*static_cast<size_t*>(block) = size;
+		heap_stats.m_allocations++;
+		heap_stats.m_bytes += size;
+		const size_t live = (heap_stats.m_live += size);
+		size_t peak = heap_stats.m_peak;
+		while (live > peak && !heap_stats.m_peak.compare_exchange_weak(peak, live))
+			;
+		return static_cast<char*>(block) + heap_header;
+	}
+
+	void Release(void* data)
+	{
+		if (!data)
+			return;
+		void* block = static_cast<char*>(data) - heap_header;
+		heap_stats.m_live -= *static_cast<size_t*>(block);
+		std::free(block);
+	}
+}
+
+void* operator new(size_t size)
+{
+	if (void* data = Allocate(size))
+		return data;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* data) noexcept { Release(data); }
+void operator delete[](void* data) noexcept { Release(data); }
+void operator delete(void* data, size_t) noexcept { Release(data); }
+void operator delete[](void* data, size_t) noexcept { Release(data); }
+void operator delete(void* data, const std::nothrow_t&) noexcept { Release(data); }
+void operator delete[](void* data, const std::nothrow_t&) noexcept { Release(data); }
+
+struct Result
+{
+	double m_seconds{};			// per document
+	size_t m_bytes{};			// processed per document
+	size_t m_nodes{};			// per document
+	size_t m_allocations{};		// per document
+	size_t m_peak{};			// heap growth during one document
+};
+
+// run the benchmark at least once and until seconds are spent, the statistics come from the first run
+template <typename Benchmark>
+Result Run(const double seconds, Benchmark&& benchmark)
+{
+	Result result{};
+	const size_t allocations{ heap_stats.m_allocations };
+	const size_t live{ heap_stats.m_live };
+	heap_stats.m_peak = live;
+
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	benchmark(result);
+	result.m_allocations = heap_stats.m_allocations - allocations;
+	result.m_peak = heap_stats.m_peak - live;
+
+	size_t runs{ 1 };
+	Result ignored{};
+	while (std::chrono::duration<double>(clock::now() - start).count() < seconds)
+	{
+		benchmark(ignored);
+		runs++;
+	}
+	result.m_seconds = std::chrono::duration<double>(clock::now() - start).count() / runs;
+	return result;
+}
+
+size_t CountNodes(const std::vector<Tag*>& tags)
+{
+	size_t nodes{};
+	std::vector<const Tag*> stack(tags.begin(), tags.end());
+	while (!stack.empty())
+	{
+		const Tag* tag = stack.back();
+		stack.pop_back();
+		nodes++;
+		stack.insert(stack.end(), tag->m_childs.begin(), tag->m_childs.end());
+	}
+	return nodes;
+}
+
+void Print(const std::string& file, const char* benchmark, const Result& result)
+{
+	char speed[32]{ "-" };
+	if (result.m_bytes)
+		std::snprintf(speed, sizeof(speed), "%.1f", result.m_bytes / result.m_seconds / (1024 * 1024));
+	std::printf("%-44s %-16s %10.3f ms %9s MB/s %8.2f Mnodes/s %9zu allocs %9zu KB peak\n",
+		file.c_str(),
+		benchmark,
+		result.m_seconds * 1e3,
+		speed,
+		result.m_nodes / result.m_seconds / 1e6,
+		result.m_allocations,
+		result.m_peak / 1024);
+}
+
+int main(int argc, char* argv[])
+{
+	const std::filesystem::path folder{ argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::current_path() / "html" };
+	const double seconds{ argc > 2 ? std::atof(argv[2]) : 0.5 };
+
+	std::vector<std::filesystem::path> files{};
+	for (const auto& entry : std::filesystem::directory_iterator(folder))
+	{
+		if (".html" == entry.path().extension())
+			files.push_back(entry.path());
+	}
+	std::sort(files.begin(), files.end());
+	if (files.empty())
+	{
+		std::cout << "no html file in " << folder << "\n";
+		return 1;
+	}
+
+	volatile size_t sink{};
+	for (const auto& path : files)
+	{
+		std::ifstream ifs(path, std::ios::binary);
+		const std::string html_file((std::istreambuf_iterator<char>(ifs)),
+			(std::istreambuf_iterator<char>()));
+		const std::string file{ path.filename().string() + " (" + std::to_string(html_file.size() / 1024) + " KB)" };
+
+		CDomTree dt{};
+		dt.Parse(html_file);
+		const size_t nodes{ CountNodes(dt.GetTags()) };
+		const std::string data{ dt.GetData() };
+		const std::string compact{ dt.GetData(DataFormat::compact) };
+
+		Print(file, "Parse", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{};
+				tree.Parse(html_file);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "Parse zero copy", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{ ParseOptions{ .m_zeroCopy = true } };
+				tree.ParseView(html_file);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "Parse lazy attrs", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{ ParseOptions{ .m_lazyAttributes = true } };
+				tree.Parse(html_file);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "Parse decoded", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{ ParseOptions{ .m_decodeEntities = true } };
+				tree.Parse(html_file);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		const ParseOptions text_only{ .m_scriptContent = ContentFilter::skip, .m_styleContent = ContentFilter::skip,
+			.m_svgContent = ContentFilter::skip, .m_comments = ContentFilter::skip };
+		CDomTree filtered{ text_only };
+		filtered.Parse(html_file);
+		const size_t filtered_nodes{ CountNodes(filtered.GetTags()) };
+		Print(file, "Parse text only", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{ text_only };
+				tree.Parse(html_file);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = filtered_nodes;
+			}));
+		Print(file, "ParseFile", Run(seconds, [&](Result& result)
+			{
+				CDomTree tree{ ParseOptions{ .m_zeroCopy = true } };
+				tree.ParseFile(path);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		const std::filesystem::path snapshot{ std::filesystem::temp_directory_path() / (path.filename().string() + ".domtree") };
+		CFlatTree{ dt }.SaveSnapshot(snapshot);
+		Print(file, "LoadSnapshot", Run(seconds, [&](Result& result)
+			{
+				CFlatTree flat{};
+				flat.LoadSnapshot(snapshot);
+				sink = sink + flat.GetCount();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "LoadSnapshot ViewFlatTree", Run(seconds, [&](Result& result)
+			{
+				CFlatTree flat{};
+				flat.LoadSnapshot(snapshot);
+				CDomTree tree{};
+				tree.ViewFlatTree(flat);
+				sink = sink + tree.GetTags().size();
+				result.m_bytes = html_file.size();
+				result.m_nodes = nodes;
+			}));
+		std::filesystem::remove(snapshot);
+		Print(file, "GetData", Run(seconds, [&](Result& result)
+			{
+				sink = sink + dt.GetData().size();
+				result.m_bytes = data.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "GetData compact", Run(seconds, [&](Result& result)
+			{
+				sink = sink + dt.GetData(DataFormat::compact).size();
+				result.m_bytes = compact.size();
+				result.m_nodes = nodes;
+			}));
+		Print(file, "Traverse", Run(seconds, [&](Result& result)
+			{
+				sink = sink + CountNodes(dt.GetTags());
+				result.m_nodes = nodes;
+			}));
+		Print(file, "Descendants", Run(seconds, [&](Result& result)
+			{
+				sink = sink + static_cast<size_t>(std::ranges::distance(dt.Descendants()));
+				result.m_nodes = nodes;
+			}));
+	}
+
+	// the tree correction must stay linear in the depth, every div looks for an open p
+	constexpr size_t depth{ 40000 };
+	std::string nested{ "<html><body>" };
+	for (size_t i = 0; i < depth; ++i)
+		nested += "<div>";
+	for (size_t i = 0; i < depth; ++i)
+		nested += "</div>";
+	nested += "</body></html>";
+	Print("nested divs (depth " + std::to_string(depth) + ")", "Parse", Run(seconds, [&](Result& result)
+		{
+			CDomTree tree{};
+			tree.Parse(nested);
+			sink = sink + tree.GetTags().size();
+			result.m_bytes = nested.size();
+			result.m_nodes = depth + 2;
+		}));
+	return 0;
+}